@@ -7,8 +7,11 @@
  * SPDX-License-Identifier: AGPL-3.0-or-later
  */
 
-int adc_setup(void); // Set up ADC drivers and inputs
-int32_t adc_probe(void); // Read Moisture Probe value, returns mv
-uint8_t adc_battery(void); // Read Battery voltage, returns percentage
+int adc_setup(void); // Set up ADC drivers and inputs, left suspended
+int adc_resume(void); // Take ADC before measuring
+void adc_suspend(void); // Disconnect inputs and release ADC after measuring
+int adc_temperature_update(void); // Read die temperature, schedules SAADC calibration if it drifted
+int32_t adc_probe(void); // Read Moisture Probe value compensated for temperature, returns mv
+int32_t adc_battery(void); // Read Battery voltage, returns mv
 
 #endif
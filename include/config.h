@@ -0,0 +1,29 @@
+#ifndef _CONFIG_H_
+#define _CONFIG_H_
+
+/*
+ * Copyright (c) 2024 Olivier DEBON
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#define PROBE_INTERVAL_MAX_S 43200 // Half a day
+
+/* Runtime tuning, exposed through Swift Configuration cluster */
+struct swift_config {
+	uint16_t probe_interval_s;
+	uint16_t probe_min_mv; // Probe output in water, 100%
+	uint16_t probe_max_mv; // Probe output in air, 0%
+	uint16_t probe_powerup_ms;
+	uint16_t report_max_interval_s;
+	uint16_t long_poll_interval_s;
+	uint8_t battery_high_100mv;
+	uint8_t battery_low_100mv;
+};
+
+extern struct swift_config swift_config; // Live values, also ZCL attributes storage
+
+void config_written(void); // Attribute written over the air, persist it
+bool config_changed(void); // True once after a change was persisted, time to apply it
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef _DELTA_H_
+#define _DELTA_H_
+
+/*
+ * Copyright (c) 2024 Olivier DEBON
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+/*
+ * Streaming applier for bsdiff-style delta images.
+ *
+ * No Zephyr dependency, so it builds on host as well (see tools/).
+ * Patches are produced by tools/swift_ota.py, format is little endian:
+ *
+ *   header:  "SWDL" old_size old_crc new_size new_crc   (u32 each)
+ *   records: diff_len extra_len seek                     (u32 u32 i32)
+ *            diff_len bytes added to old image, zero runs coded as 0x00 n (n+1 zeros)
+ *            extra_len raw bytes
+ *            seek applied to old image position
+ *
+ * CRCs are CRC-32 (IEEE). Old one is checked against base image before
+ * anything is written, new one once whole image has been produced.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DELTA_MAGIC "SWDL"
+#define DELTA_HEADER_SIZE 20
+#define DELTA_CTRL_SIZE 12
+#define DELTA_CHUNK 64
+
+typedef int (*delta_read_t)(void *user, uint32_t offset, uint8_t *data, size_t len); // Read base image
+typedef int (*delta_write_t)(void *user, const uint8_t *data, size_t len); // Append to new image
+
+struct delta_ctx {
+	delta_read_t read_old;
+	delta_write_t write_new;
+	void *user;
+
+	uint8_t state;
+	uint8_t field[DELTA_HEADER_SIZE]; // Header or control record being received
+	uint8_t field_len;
+	uint8_t zero_token; // 0x00 received, waiting for run length
+
+	uint32_t old_size;
+	uint32_t old_crc;
+	uint32_t new_size;
+	uint32_t new_crc;
+
+	uint32_t diff_left;
+	uint32_t extra_left;
+	int32_t seek;
+
+	uint32_t old_pos;
+	uint32_t new_pos;
+	uint32_t crc;
+
+	uint8_t buf[DELTA_CHUNK]; // Pending diff bytes
+	uint8_t buf_len;
+};
+
+uint32_t delta_crc32(uint32_t crc, const uint8_t *data, size_t len); // Update running CRC-32, start with 0
+
+void delta_init(struct delta_ctx *ctx, delta_read_t read_old, delta_write_t write_new, void *user);
+int delta_write(struct delta_ctx *ctx, const uint8_t *data, size_t len); // Feed patch bytes, returns 0 or -errno
+int delta_finish(struct delta_ctx *ctx); // Check new image is complete and sound, returns 0 or -errno
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef _GOVERNOR_H_
+#define _GOVERNOR_H_
+
+/*
+ * Copyright (c) 2024 Olivier DEBON
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+/*
+ * Battery energy governor.
+ *
+ * Estimates remaining capacity from battery voltage measured under probe
+ * load, and stretches intervals in stages as capacity falls.
+ */
+
+#define GOVERNOR_INTERVAL_SHIFT_MAX 3 // Intervals are stretched up to 8 times
+
+bool governor_update(int32_t battery_mv); // Feed a battery measurement, true when stage changed
+int32_t governor_voltage(void); // Filtered battery voltage, mv
+uint8_t governor_capacity(void); // Remaining capacity, percent
+uint32_t governor_alarm_state(void); // Power Config BatteryAlarmState bits, 32-bit bitmap
+uint32_t governor_interval(uint32_t base); // Stretched sampling and reporting interval
+uint32_t governor_long_poll(uint32_t base); // Stretched long poll interval
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef _OTA_H_
+#define _OTA_H_
+
+/*
+ * Copyright (c) 2024 Olivier DEBON
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+/* Largest Image Block payload requested from OTA server */
+#define OTA_IMAGE_BLOCK_DATA_SIZE_MAX 64
+
+/* OTA file sub-element tags */
+#define OTA_TAG_UPGRADE_IMAGE 0x0000
+#define OTA_TAG_SWIFT_DELTA 0xF000 // Manufacturer specific, see include/delta.h
+
+void ota_confirm_image(void); // Mark running image good, call once network is joined
+void ota_client_start(void); // Start OTA server discovery and periodic image queries
+void ota_upgrade_cb(zb_zcl_ota_upgrade_value_param_t *value); // Handle ZB_ZCL_OTA_UPGRADE_VALUE_CB_ID
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef _TXPOWER_H_
+#define _TXPOWER_H_
+
+/*
+ * Copyright (c) 2024 Olivier DEBON
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+void txpower_apply(void); // Program radio with current TX power level, call once joined
+void txpower_update(void); // Sample parent link quality and adjust TX power level
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef _UI_H_
+#define _UI_H_
+
+/*
+ * Copyright (c) 2024 Olivier DEBON
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+/*
+ * Button gestures and LED patterns.
+ *
+ * Button events come from GPIO interrupts through DK library callbacks,
+ * LED patterns are driven by a kernel timer. Nothing here runs in or
+ * blocks Zigbee stack thread.
+ *
+ *   short press: identify, LED blinks and a measurement is made
+ *   long press:  factory reset
+ */
+
+enum ui_led_pattern {
+	UI_LED_OFF,
+	UI_LED_ON, // While measuring
+	UI_LED_JOINING, // Until network is joined
+	UI_LED_IDENTIFY, // For a few seconds, then back to previous pattern
+	UI_LED_RESET, // Until button is released
+};
+
+void ui_init(zb_callback_t identify_cb); // Identify callback is scheduled in Zigbee stack context
+void ui_led(enum ui_led_pattern pattern);
+void ui_leave(void); // Network left, reboot once factory reset button is released
+
+#endif
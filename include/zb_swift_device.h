@@ -19,6 +19,8 @@
  *  @details
  *      - @ref ZB_ZCL_IDENTIFY \n
  *      - @ref ZB_ZCL_BASIC
+ *      - Swift Configuration (manufacturer specific)
+ *      - @ref ZB_ZCL_OTA_UPGRADE (client)
  */
 
 /** Swift Device ID*/
@@ -30,10 +32,10 @@
 /** @cond internals_doc */
 
 /** Swift Device IN (server) clusters number */
-#define ZB_SWIFT_DEVICE_IN_CLUSTER_NUM 3
+#define ZB_SWIFT_DEVICE_IN_CLUSTER_NUM 4
 
 /** Swift Device OUT (client) clusters number */
-#define ZB_SWIFT_DEVICE_OUT_CLUSTER_NUM 0
+#define ZB_SWIFT_DEVICE_OUT_CLUSTER_NUM 1
 
 #define ZB_SWIFT_DEVICE_CLUSTER_NUM \
 	(ZB_SWIFT_DEVICE_IN_CLUSTER_NUM + ZB_SWIFT_DEVICE_OUT_CLUSTER_NUM)
@@ -60,9 +62,71 @@ typedef struct {
 typedef struct {
     zb_uint8_t voltage;
     zb_uint8_t percentage_remaining; // Reportable
-    zb_uint8_t alarm_state; // Reportable
+    zb_uint32_t alarm_state; // Reportable, 32-bit bitmap
 } zb_zcl_power_config_attrs_t;
 
+typedef struct {
+    zb_ieee_addr_t upgrade_server;
+    zb_uint32_t file_offset;
+    zb_uint32_t file_version;
+    zb_uint16_t stack_version;
+    zb_uint32_t downloaded_file_ver;
+    zb_uint16_t downloaded_stack_ver;
+    zb_uint8_t image_status;
+    zb_uint16_t manufacturer;
+    zb_uint16_t image_type;
+    zb_uint16_t min_block_reque;
+    zb_uint16_t image_stamp;
+    zb_uint16_t server_addr;
+    zb_uint8_t server_ep;
+} zb_zcl_ota_upgrade_client_attrs_t;
+
+/** Swift Configuration cluster, manufacturer specific */
+#define ZB_ZCL_CLUSTER_ID_SWIFT_CONFIG 0xFC00
+
+#define ZB_ZCL_SWIFT_CONFIG_CLUSTER_REVISION_DEFAULT ((zb_uint16_t)0x0001u)
+
+#define ZB_ZCL_CLUSTER_ID_SWIFT_CONFIG_SERVER_ROLE_INIT zb_zcl_swift_config_init_server
+#define ZB_ZCL_CLUSTER_ID_SWIFT_CONFIG_CLIENT_ROLE_INIT (zb_zcl_cluster_init_t)NULL
+
+void zb_zcl_swift_config_init_server(void);
+
+/** Swift Configuration attributes, all writable and persisted */
+enum zb_zcl_swift_config_attr_e {
+    ZB_ZCL_ATTR_SWIFT_CONFIG_PROBE_INTERVAL_ID = 0x0000, // s
+    ZB_ZCL_ATTR_SWIFT_CONFIG_PROBE_MIN_MV_ID = 0x0001, // Probe output in water
+    ZB_ZCL_ATTR_SWIFT_CONFIG_PROBE_MAX_MV_ID = 0x0002, // Probe output in air
+    ZB_ZCL_ATTR_SWIFT_CONFIG_PROBE_POWERUP_TIME_ID = 0x0003, // ms
+    ZB_ZCL_ATTR_SWIFT_CONFIG_REPORT_MAX_INTERVAL_ID = 0x0004, // s
+    ZB_ZCL_ATTR_SWIFT_CONFIG_LONG_POLL_INTERVAL_ID = 0x0005, // s
+    ZB_ZCL_ATTR_SWIFT_CONFIG_BATTERY_HIGH_ID = 0x0006, // 100mV
+    ZB_ZCL_ATTR_SWIFT_CONFIG_BATTERY_LOW_ID = 0x0007, // 100mV
+};
+
+#define ZB_ZCL_SWIFT_CONFIG_ATTR_DESCR(attr_id, attr_type, data_ptr) \
+{                                                                     \
+    attr_id,                                                          \
+    attr_type,                                                        \
+    ZB_ZCL_ATTR_ACCESS_READ_WRITE | ZB_ZCL_ATTR_MANUF_SPEC,           \
+    (CONFIG_SWIFT_MANUFACTURER_CODE),                                 \
+    (void*) data_ptr                                                  \
+}
+
+#define ZB_ZCL_DECLARE_SWIFT_CONFIG_ATTRIB_LIST(attr_list,                                       \
+                                                probe_interval, probe_min_mv, probe_max_mv,      \
+                                                probe_powerup_time, report_max_interval,         \
+                                                long_poll_interval, battery_high, battery_low)   \
+  ZB_ZCL_START_DECLARE_ATTRIB_LIST_CLUSTER_REVISION(attr_list, ZB_ZCL_SWIFT_CONFIG)               \
+  ZB_ZCL_SWIFT_CONFIG_ATTR_DESCR(ZB_ZCL_ATTR_SWIFT_CONFIG_PROBE_INTERVAL_ID, ZB_ZCL_ATTR_TYPE_U16, probe_interval), \
+  ZB_ZCL_SWIFT_CONFIG_ATTR_DESCR(ZB_ZCL_ATTR_SWIFT_CONFIG_PROBE_MIN_MV_ID, ZB_ZCL_ATTR_TYPE_U16, probe_min_mv), \
+  ZB_ZCL_SWIFT_CONFIG_ATTR_DESCR(ZB_ZCL_ATTR_SWIFT_CONFIG_PROBE_MAX_MV_ID, ZB_ZCL_ATTR_TYPE_U16, probe_max_mv), \
+  ZB_ZCL_SWIFT_CONFIG_ATTR_DESCR(ZB_ZCL_ATTR_SWIFT_CONFIG_PROBE_POWERUP_TIME_ID, ZB_ZCL_ATTR_TYPE_U16, probe_powerup_time), \
+  ZB_ZCL_SWIFT_CONFIG_ATTR_DESCR(ZB_ZCL_ATTR_SWIFT_CONFIG_REPORT_MAX_INTERVAL_ID, ZB_ZCL_ATTR_TYPE_U16, report_max_interval), \
+  ZB_ZCL_SWIFT_CONFIG_ATTR_DESCR(ZB_ZCL_ATTR_SWIFT_CONFIG_LONG_POLL_INTERVAL_ID, ZB_ZCL_ATTR_TYPE_U16, long_poll_interval), \
+  ZB_ZCL_SWIFT_CONFIG_ATTR_DESCR(ZB_ZCL_ATTR_SWIFT_CONFIG_BATTERY_HIGH_ID, ZB_ZCL_ATTR_TYPE_U8, battery_high), \
+  ZB_ZCL_SWIFT_CONFIG_ATTR_DESCR(ZB_ZCL_ATTR_SWIFT_CONFIG_BATTERY_LOW_ID, ZB_ZCL_ATTR_TYPE_U8, battery_low), \
+  ZB_ZCL_FINISH_DECLARE_ATTRIB_LIST
+
 /** @endcond */ /* internals_doc */
 
 /**
@@ -71,12 +135,16 @@ typedef struct {
  * @param basic_attr_list - attribute list for Basic cluster
  * @param power_attr_list - attribute list for Power Config cluster
  * @param rh_humidity_attr_list - attribute list for Relative Humidity Cluster
+ * @param swift_config_attr_list - attribute list for Swift Configuration Cluster
+ * @param ota_upgrade_attr_list - attribute list for OTA Upgrade client Cluster
  */
 #define ZB_DECLARE_SWIFT_DEVICE_CLUSTER_LIST(			      \
 		cluster_list_name,				      \
 		basic_attr_list,				      \
 		power_attr_list,				      \
-		rh_humidity_attr_list)				      \
+		rh_humidity_attr_list,				      \
+		swift_config_attr_list,				      \
+		ota_upgrade_attr_list)				      \
 zb_zcl_cluster_desc_t cluster_list_name[] =			      \
 {								      \
 	ZB_ZCL_CLUSTER_DESC(					      \
@@ -99,6 +167,20 @@ zb_zcl_cluster_desc_t cluster_list_name[] =			      \
 		(rh_humidity_attr_list),			      \
 		ZB_ZCL_CLUSTER_SERVER_ROLE,			      \
 		ZB_ZCL_MANUF_CODE_INVALID			      \
+	),							      \
+	ZB_ZCL_CLUSTER_DESC(					      \
+		ZB_ZCL_CLUSTER_ID_SWIFT_CONFIG,			      \
+		ZB_ZCL_ARRAY_SIZE(swift_config_attr_list, zb_zcl_attr_t),  \
+		(swift_config_attr_list),			      \
+		ZB_ZCL_CLUSTER_SERVER_ROLE,			      \
+		CONFIG_SWIFT_MANUFACTURER_CODE			      \
+	),							      \
+	ZB_ZCL_CLUSTER_DESC(					      \
+		ZB_ZCL_CLUSTER_ID_OTA_UPGRADE,			      \
+		ZB_ZCL_ARRAY_SIZE(ota_upgrade_attr_list, zb_zcl_attr_t),   \
+		(ota_upgrade_attr_list),			      \
+		ZB_ZCL_CLUSTER_CLIENT_ROLE,			      \
+		ZB_ZCL_MANUF_CODE_INVALID			      \
 	)							      \
 }
 
@@ -125,7 +207,9 @@ zb_zcl_cluster_desc_t cluster_list_name[] =			      \
 		{									       \
 			ZB_ZCL_CLUSTER_ID_BASIC,					       \
 			ZB_ZCL_CLUSTER_ID_POWER_CONFIG,					       \
-			ZB_ZCL_CLUSTER_ID_REL_HUMIDITY_MEASUREMENT			       \
+			ZB_ZCL_CLUSTER_ID_REL_HUMIDITY_MEASUREMENT,			       \
+			ZB_ZCL_CLUSTER_ID_SWIFT_CONFIG,					       \
+			ZB_ZCL_CLUSTER_ID_OTA_UPGRADE					       \
 		}									       \
 	}
 
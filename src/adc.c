@@ -14,12 +14,15 @@
 #include <inttypes.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdlib.h>
 
 #include <zephyr/device.h>
 #include <zephyr/devicetree.h>
 #include <zephyr/drivers/adc.h>
+#include <zephyr/drivers/sensor.h>
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
+#include <zephyr/pm/device_runtime.h>
 
 LOG_MODULE_REGISTER(adc, LOG_LEVEL_INF);
 
@@ -37,7 +40,7 @@ static const struct adc_dt_spec adc_channels[] = {
 			     DT_SPEC_AND_COMMA)
 };
 
-int adc_setup(void)
+static int adc_channels_setup(void)
 {
 	int err;
 
@@ -68,6 +71,80 @@ int adc_setup(void)
 	return 1; // Ok
 }
 
+static const struct device *const die_temp = DEVICE_DT_GET_ONE(nordic_nrf_temp);
+
+#define TEMP_UNKNOWN INT32_MIN
+
+static int32_t temp_c100 = TEMP_UNKNOWN; // Die temperature of current wake window
+static int32_t calibration_temp_c100 = TEMP_UNKNOWN; // Die temperature at last SAADC calibration
+static bool calibrate = true; // Offset calibration on next conversion
+
+int adc_temperature_update(void)
+{
+	struct sensor_value val;
+	int err;
+
+	temp_c100 = TEMP_UNKNOWN; // Don't carry previous window value over a failed read
+
+	if (!device_is_ready(die_temp)) {
+		LOG_ERR("Die temperature sensor not ready");
+		return 0;
+	}
+
+	err = sensor_sample_fetch(die_temp);
+	if (!err) {
+		err = sensor_channel_get(die_temp, SENSOR_CHAN_DIE_TEMP, &val);
+	}
+
+	if (err) {
+		LOG_ERR("Could not read die temperature (%d)", err);
+		return 0;
+	}
+
+	temp_c100 = val.val1*100 + val.val2/10000;
+
+	// SAADC offset drifts with temperature, calibration is only worth it when it moved
+	if (calibration_temp_c100 == TEMP_UNKNOWN ||
+	    abs(temp_c100 - calibration_temp_c100) > CONFIG_ADC_CALIBRATION_TEMP_DELTA*100) {
+		calibrate = true;
+	}
+
+	LOG_INF("Die temperature %d.%02d C%s", temp_c100/100, abs(temp_c100%100), calibrate ? ", calibrating" : "");
+
+	return 1; // Ok
+}
+
+int adc_setup(void)
+{
+	// SAADC driver of NCS 2.6.1 doesn't implement PM, then get/put are no-ops.
+	// Kept so that ADC is released once driver supports it.
+	(void)pm_device_runtime_enable(adc_channels[0].dev);
+
+	return adc_channels_setup(); // Inputs left disconnected until first measurement
+}
+
+int adc_resume(void)
+{
+	int err;
+
+	err = pm_device_runtime_get(adc_channels[0].dev);
+	if (err < 0) {
+		LOG_ERR("Could not resume ADC (%d)", err);
+		return 0;
+	}
+
+	return 1; // Ok, driver connects each input while sampling it
+}
+
+void adc_suspend(void)
+{
+	// Driver leaves last sampled input connected. Setting channels up again
+	// disconnects them from probe and battery divider, in sync with driver.
+	(void)adc_channels_setup();
+
+	(void)pm_device_runtime_put(adc_channels[0].dev);
+}
+
 int32_t adc_probe()
 {
 	int err;
@@ -81,22 +158,34 @@ int32_t adc_probe()
 
 	(void)adc_sequence_init_dt(&adc_channels[0], &sequence);
 
+	sequence.calibrate = calibrate;
+
 	err = adc_read(adc_channels[0].dev, &sequence);
 	if (err < 0) {
 		LOG_ERR("Could not read (%d)\n", err);
 		return -1;
 	}
 
+	if (calibrate) {
+		calibrate = false;
+		calibration_temp_c100 = temp_c100;
+	}
+
 	val_mv = (int32_t)((int16_t)buf);
 
 	err = adc_raw_to_millivolts_dt(&adc_channels[0], &val_mv);
 
+	// Probe output drifts with temperature, bring it back to reference temperature
+	if (temp_c100 != TEMP_UNKNOWN) {
+		val_mv -= CONFIG_PROBE_TEMPCO_UV_PER_C * (temp_c100 - CONFIG_PROBE_TEMPCO_REF_TEMP*100) / 100000;
+	}
+
 	LOG_INF("- %s, channel %d: %"PRId32" mV", adc_channels[0].dev->name, adc_channels[0].channel_id, val_mv);
 
 	return val_mv;
 }
 
-uint8_t adc_battery()
+int32_t adc_battery()
 {
 	int err;
 	uint16_t buf;
@@ -117,9 +206,9 @@ uint8_t adc_battery()
 
 	val_mv = (int32_t)((int16_t)buf);
 
-	err = adc_raw_to_millivolts_dt(&adc_channels[0], &val_mv);
+	err = adc_raw_to_millivolts_dt(&adc_channels[1], &val_mv);
 
 	LOG_INF("- %s, channel %d: %"PRId32" mV", adc_channels[1].dev->name, adc_channels[1].channel_id, val_mv);
 
-	return (uint8_t)(val_mv/100);
+	return val_mv;
 }
@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2024 Olivier DEBON
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include <stdint.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/settings/settings.h>
+
+#include <zboss_api.h>
+#include "zb_swift_device.h"
+#include "config.h"
+
+LOG_MODULE_REGISTER(config, LOG_LEVEL_INF);
+
+#ifdef VDD_3V
+// These comes from Capacitive Soil Moisture Sensor v1.2 powered by 3.0V
+#pragma message("Probe supply 3V")
+#define MIN_MV 450
+#define MAX_MV 1825
+#else
+// These come from Capacitive Soil Moisture Sensor v1.2 powered by 3.3V
+#define MIN_MV 910
+#define MAX_MV 2160
+#endif
+
+#define PERSIST_DELAY_MS 1000 // Several attributes are usually written in a row
+
+struct swift_config swift_config = {
+	.probe_interval_s = CONFIG_PROBE_INTERVAL,
+	.probe_min_mv = MIN_MV,
+	.probe_max_mv = MAX_MV,
+	.probe_powerup_ms = 1000,
+	.report_max_interval_s = 7200, // 2 hours
+	.long_poll_interval_s = 120, // 2 minutes should be enough
+	.battery_high_100mv = 28,
+	.battery_low_100mv = 16,
+};
+
+static bool changed = false;
+
+static bool config_valid(const struct swift_config *cfg)
+{
+	return cfg->probe_interval_s >= 10 && cfg->probe_interval_s <= PROBE_INTERVAL_MAX_S &&
+	       cfg->probe_min_mv < cfg->probe_max_mv && cfg->probe_max_mv <= 3600 &&
+	       cfg->probe_powerup_ms >= 10 && cfg->probe_powerup_ms <= 5000 &&
+	       cfg->report_max_interval_s >= cfg->probe_interval_s &&
+	       // Longer than a few minutes broke rejoin and reparenting in the field
+	       cfg->long_poll_interval_s >= 1 && cfg->long_poll_interval_s <= 600 &&
+	       cfg->battery_low_100mv < cfg->battery_high_100mv && cfg->battery_high_100mv <= 36;
+}
+
+static int config_settings_set(const char *name, size_t len,
+			       settings_read_cb read_cb, void *cb_arg)
+{
+	struct swift_config cfg;
+
+	// Layout changes drop stored values, defaults are used instead
+	if (!settings_name_steq(name, "all", NULL) || len != sizeof(cfg)) {
+		return -ENOENT;
+	}
+
+	if (read_cb(cb_arg, &cfg, sizeof(cfg)) < 0) {
+		return -EIO;
+	}
+
+	if (!config_valid(&cfg)) {
+		LOG_ERR("Ignoring invalid stored configuration");
+		return -EINVAL;
+	}
+
+	swift_config = cfg;
+
+	LOG_INF("Restored configuration");
+
+	return 0;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(config, "config", NULL, config_settings_set, NULL, NULL);
+
+/* Reject writes that would leave configuration inconsistent */
+static zb_ret_t config_check_value(zb_uint16_t attr_id, zb_uint8_t endpoint, zb_uint8_t *value)
+{
+	struct swift_config cfg = swift_config;
+
+	switch (attr_id) {
+	case ZB_ZCL_ATTR_SWIFT_CONFIG_PROBE_INTERVAL_ID:
+	    cfg.probe_interval_s = ZB_ZCL_ATTR_GET16(value);
+	    break;
+	case ZB_ZCL_ATTR_SWIFT_CONFIG_PROBE_MIN_MV_ID:
+	    cfg.probe_min_mv = ZB_ZCL_ATTR_GET16(value);
+	    break;
+	case ZB_ZCL_ATTR_SWIFT_CONFIG_PROBE_MAX_MV_ID:
+	    cfg.probe_max_mv = ZB_ZCL_ATTR_GET16(value);
+	    break;
+	case ZB_ZCL_ATTR_SWIFT_CONFIG_PROBE_POWERUP_TIME_ID:
+	    cfg.probe_powerup_ms = ZB_ZCL_ATTR_GET16(value);
+	    break;
+	case ZB_ZCL_ATTR_SWIFT_CONFIG_REPORT_MAX_INTERVAL_ID:
+	    cfg.report_max_interval_s = ZB_ZCL_ATTR_GET16(value);
+	    break;
+	case ZB_ZCL_ATTR_SWIFT_CONFIG_LONG_POLL_INTERVAL_ID:
+	    cfg.long_poll_interval_s = ZB_ZCL_ATTR_GET16(value);
+	    break;
+	case ZB_ZCL_ATTR_SWIFT_CONFIG_BATTERY_HIGH_ID:
+	    cfg.battery_high_100mv = *value;
+	    break;
+	case ZB_ZCL_ATTR_SWIFT_CONFIG_BATTERY_LOW_ID:
+	    cfg.battery_low_100mv = *value;
+	    break;
+	default:
+	    return RET_OK; // Cluster revision...
+	}
+
+	if (!config_valid(&cfg)) {
+	    LOG_INF("Rejecting value of attribute 0x%04x", attr_id);
+	    return RET_ERROR;
+	}
+
+	return RET_OK;
+}
+
+void zb_zcl_swift_config_init_server(void)
+{
+	zb_zcl_add_cluster_handlers(ZB_ZCL_CLUSTER_ID_SWIFT_CONFIG,
+				    ZB_ZCL_CLUSTER_SERVER_ROLE,
+				    config_check_value,
+				    (zb_zcl_cluster_write_attr_hook_t)NULL,
+				    (zb_zcl_cluster_handler_t)NULL);
+}
+
+static void config_persist(zb_uint8_t param)
+{
+	if (settings_save_one("config/all", &swift_config, sizeof(swift_config))) {
+	    LOG_ERR("Can't persist configuration");
+	}
+
+	changed = true;
+}
+
+void config_written(void)
+{
+	ZB_SCHEDULE_APP_ALARM_CANCEL(config_persist, ZB_ALARM_ANY_PARAM);
+	ZB_SCHEDULE_APP_ALARM(config_persist, 0, ZB_MILLISECONDS_TO_BEACON_INTERVAL(PERSIST_DELAY_MS));
+}
+
+bool config_changed(void)
+{
+	bool c = changed;
+
+	changed = false;
+
+	return c;
+}
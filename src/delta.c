@@ -0,0 +1,280 @@
+/*
+ * Copyright (c) 2024 Olivier DEBON
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include "delta.h"
+
+enum {
+	DELTA_STATE_HEADER,
+	DELTA_STATE_CTRL,
+	DELTA_STATE_DIFF,
+	DELTA_STATE_EXTRA,
+	DELTA_STATE_DONE,
+	DELTA_STATE_ERROR,
+};
+
+static uint32_t get_u32(const uint8_t *p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+uint32_t delta_crc32(uint32_t crc, const uint8_t *data, size_t len)
+{
+	crc = ~crc;
+
+	while (len--) {
+		crc ^= *data++;
+		for (int b = 0; b < 8; b++) {
+			crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+		}
+	}
+
+	return ~crc;
+}
+
+void delta_init(struct delta_ctx *ctx, delta_read_t read_old, delta_write_t write_new, void *user)
+{
+	memset(ctx, 0, sizeof(*ctx));
+
+	ctx->read_old = read_old;
+	ctx->write_new = write_new;
+	ctx->user = user;
+	ctx->state = DELTA_STATE_HEADER;
+}
+
+static int fail(struct delta_ctx *ctx, int err)
+{
+	ctx->state = DELTA_STATE_ERROR;
+	return err;
+}
+
+static int emit(struct delta_ctx *ctx, const uint8_t *data, size_t len)
+{
+	int err;
+
+	err = ctx->write_new(ctx->user, data, len);
+	if (err < 0) {
+		return err;
+	}
+
+	ctx->crc = delta_crc32(ctx->crc, data, len);
+	ctx->new_pos += len;
+
+	return 0;
+}
+
+/* Add pending diff bytes to base image and output them */
+static int flush_diff(struct delta_ctx *ctx)
+{
+	uint8_t old[DELTA_CHUNK];
+	int err;
+
+	if (ctx->buf_len == 0) {
+		return 0;
+	}
+
+	err = ctx->read_old(ctx->user, ctx->old_pos, old, ctx->buf_len);
+	if (err < 0) {
+		return err;
+	}
+
+	for (int i = 0; i < ctx->buf_len; i++) {
+		ctx->buf[i] += old[i];
+	}
+
+	err = emit(ctx, ctx->buf, ctx->buf_len);
+	if (err < 0) {
+		return err;
+	}
+
+	ctx->old_pos += ctx->buf_len;
+	ctx->buf_len = 0;
+
+	return 0;
+}
+
+/* Base image must match the one patch was built against */
+static int check_old(struct delta_ctx *ctx)
+{
+	uint8_t old[DELTA_CHUNK];
+	uint32_t crc = 0;
+	int err;
+
+	for (uint32_t pos = 0; pos < ctx->old_size; pos += sizeof(old)) {
+		size_t len = ctx->old_size - pos < sizeof(old) ? ctx->old_size - pos : sizeof(old);
+
+		err = ctx->read_old(ctx->user, pos, old, len);
+		if (err < 0) {
+			return err;
+		}
+
+		crc = delta_crc32(crc, old, len);
+	}
+
+	return crc == ctx->old_crc ? 0 : -EINVAL;
+}
+
+/* Move on after a diff or extra block completed */
+static int next_block(struct delta_ctx *ctx)
+{
+	int64_t pos;
+
+	if (ctx->diff_left) {
+		ctx->state = DELTA_STATE_DIFF;
+		return 0;
+	}
+
+	if (ctx->extra_left) {
+		ctx->state = DELTA_STATE_EXTRA;
+		return 0;
+	}
+
+	pos = (int64_t)ctx->old_pos + ctx->seek;
+	if (pos < 0 || pos > ctx->old_size) {
+		return -EINVAL;
+	}
+
+	ctx->old_pos = (uint32_t)pos;
+	ctx->state = ctx->new_pos == ctx->new_size ? DELTA_STATE_DONE : DELTA_STATE_CTRL;
+
+	return 0;
+}
+
+static int parse_header(struct delta_ctx *ctx)
+{
+	if (memcmp(ctx->field, DELTA_MAGIC, 4) != 0) {
+		return -EINVAL;
+	}
+
+	ctx->old_size = get_u32(&ctx->field[4]);
+	ctx->old_crc = get_u32(&ctx->field[8]);
+	ctx->new_size = get_u32(&ctx->field[12]);
+	ctx->new_crc = get_u32(&ctx->field[16]);
+
+	ctx->state = ctx->new_size ? DELTA_STATE_CTRL : DELTA_STATE_DONE;
+
+	return check_old(ctx);
+}
+
+static int parse_ctrl(struct delta_ctx *ctx)
+{
+	ctx->diff_left = get_u32(&ctx->field[0]);
+	ctx->extra_left = get_u32(&ctx->field[4]);
+	ctx->seek = (int32_t)get_u32(&ctx->field[8]);
+
+	if ((uint64_t)ctx->new_pos + ctx->diff_left + ctx->extra_left > ctx->new_size ||
+	    (uint64_t)ctx->old_pos + ctx->diff_left > ctx->old_size) {
+		return -EINVAL;
+	}
+
+	return next_block(ctx);
+}
+
+/* Queue decoded diff bytes, count of them is already checked against diff_left */
+static int push_diff(struct delta_ctx *ctx, uint8_t value, uint32_t count)
+{
+	int err;
+
+	ctx->diff_left -= count;
+
+	while (count--) {
+		ctx->buf[ctx->buf_len++] = value;
+		if (ctx->buf_len == sizeof(ctx->buf)) {
+			err = flush_diff(ctx);
+			if (err < 0) {
+				return err;
+			}
+		}
+	}
+
+	if (ctx->diff_left == 0) {
+		err = flush_diff(ctx);
+		if (err < 0) {
+			return err;
+		}
+		return next_block(ctx);
+	}
+
+	return 0;
+}
+
+int delta_write(struct delta_ctx *ctx, const uint8_t *data, size_t len)
+{
+	int err = 0;
+
+	while (len) {
+		switch (ctx->state) {
+		case DELTA_STATE_HEADER:
+		case DELTA_STATE_CTRL: {
+			size_t size = ctx->state == DELTA_STATE_HEADER ? DELTA_HEADER_SIZE : DELTA_CTRL_SIZE;
+
+			ctx->field[ctx->field_len++] = *data++;
+			len--;
+
+			if (ctx->field_len == size) {
+				ctx->field_len = 0;
+				err = ctx->state == DELTA_STATE_HEADER ? parse_header(ctx) : parse_ctrl(ctx);
+			}
+			break;
+		}
+		case DELTA_STATE_DIFF: {
+			uint8_t b = *data++;
+
+			len--;
+
+			if (ctx->zero_token) {
+				ctx->zero_token = 0;
+				if ((uint32_t)b + 1 > ctx->diff_left) {
+					return fail(ctx, -EINVAL);
+				}
+				err = push_diff(ctx, 0, (uint32_t)b + 1);
+			} else if (b == 0) {
+				ctx->zero_token = 1;
+			} else {
+				err = push_diff(ctx, b, 1);
+			}
+			break;
+		}
+		case DELTA_STATE_EXTRA: {
+			size_t n = len < ctx->extra_left ? len : ctx->extra_left;
+
+			err = emit(ctx, data, n);
+			if (err < 0) {
+				break;
+			}
+
+			data += n;
+			len -= n;
+			ctx->extra_left -= n;
+
+			if (ctx->extra_left == 0) {
+				err = next_block(ctx);
+			}
+			break;
+		}
+		default:
+			// Trailing garbage or previous error
+			return fail(ctx, -EINVAL);
+		}
+
+		if (err < 0) {
+			return fail(ctx, err);
+		}
+	}
+
+	return 0;
+}
+
+int delta_finish(struct delta_ctx *ctx)
+{
+	if (ctx->state != DELTA_STATE_DONE) {
+		return -EINVAL;
+	}
+
+	return ctx->crc == ctx->new_crc ? 0 : -EINVAL;
+}
@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2024 Olivier DEBON
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include <stdint.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#include "config.h"
+#include "governor.h"
+
+LOG_MODULE_REGISTER(governor, LOG_LEVEL_INF);
+
+/* CR2032 discharge curve under ~10mA probe load.
+ * Voltage is per mille of battery_low..battery_high span, so it follows
+ * configured thresholds. Flat at first, then a knee near the end.
+ */
+static const struct {
+	uint16_t span; // ‰
+	uint8_t capacity; // %
+} curve[] = {
+	{ 1000, 100 },
+	{ 917, 80 },
+	{ 833, 55 },
+	{ 750, 35 },
+	{ 667, 20 },
+	{ 583, 11 },
+	{ 500, 6 },
+	{ 333, 2 },
+	{ 0, 0 },
+};
+
+/* Energy stages, entered when capacity falls below threshold */
+static const struct {
+	uint8_t capacity; // %
+	uint8_t interval_shift; // Sampling and reporting intervals multiplied by 2^shift
+	uint8_t poll_shift; // Long poll interval, stretched less: rejoin and reparenting suffer
+	uint32_t alarm; // BatteryAlarmState bits, thresholds above remain crossed
+} stages[] = {
+	{ 100, 0, 0, 0 },
+	{ 30, 1, 0, BIT(1) }, // Threshold 1
+	{ 15, 2, 1, BIT(1) | BIT(2) }, // Threshold 2
+	{ 5, GOVERNOR_INTERVAL_SHIFT_MAX, 1, BIT(0) | BIT(1) | BIT(2) | BIT(3) }, // Threshold 3, about to stop
+};
+
+#define STAGE_RECOVERY 10 // Capacity margin (%) to leave a stage, i.e. battery replaced
+#define LONG_POLL_MAX_S 600
+
+static int32_t voltage_mv = -1;
+static uint8_t capacity = 100;
+static uint8_t stage = 0;
+
+static uint8_t capacity_from_voltage(int32_t mv)
+{
+	int32_t low = swift_config.battery_low_100mv * 100;
+	int32_t high = swift_config.battery_high_100mv * 100;
+	int32_t span;
+
+	if (mv >= high) {
+		return 100;
+	}
+
+	if (mv <= low) {
+		return 0;
+	}
+
+	span = (mv - low) * 1000 / (high - low);
+
+	for (int i = 1; i < ARRAY_SIZE(curve); i++) {
+		if (span >= curve[i].span) {
+			return curve[i].capacity + (span - curve[i].span) *
+			       (curve[i-1].capacity - curve[i].capacity) /
+			       (curve[i-1].span - curve[i].span);
+		}
+	}
+
+	return 0;
+}
+
+bool governor_update(int32_t battery_mv)
+{
+	uint8_t previous = stage;
+
+	if (battery_mv < 0) {
+	    return false; // ADC failure
+	}
+
+	// Low filter, voltage under load is noisy
+	if (voltage_mv >= 0) {
+	    battery_mv = (voltage_mv*3 + battery_mv + 2)/4;
+	}
+
+	voltage_mv = battery_mv;
+	capacity = capacity_from_voltage(voltage_mv);
+
+	// Go down as soon as capacity is below threshold, up only with clear margin
+	while (stage < ARRAY_SIZE(stages) - 1 && capacity < stages[stage+1].capacity) {
+	    stage++;
+	}
+
+	while (stage > 0 && capacity >= stages[stage].capacity + STAGE_RECOVERY) {
+	    stage--;
+	}
+
+	if (stage != previous) {
+	    LOG_INF("Battery %d mv (%d%%), energy stage %d -> %d", voltage_mv, capacity, previous, stage);
+	}
+
+	return stage != previous;
+}
+
+int32_t governor_voltage(void)
+{
+	return voltage_mv;
+}
+
+uint8_t governor_capacity(void)
+{
+	return capacity;
+}
+
+uint32_t governor_alarm_state(void)
+{
+	return stages[stage].alarm;
+}
+
+uint32_t governor_interval(uint32_t base)
+{
+	return base << stages[stage].interval_shift;
+}
+
+uint32_t governor_long_poll(uint32_t base)
+{
+	return MIN(base << stages[stage].poll_shift, MAX(base, LONG_POLL_MAX_S));
+}
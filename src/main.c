@@ -18,8 +18,11 @@
 
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
 #include <zephyr/drivers/gpio.h>
-#include <zephyr/sys/reboot.h>
+#include <zephyr/settings/settings.h>
+#include <zephyr/logging/log_ctrl.h>
+#include <zephyr/pm/device_runtime.h>
 #include <dk_buttons_and_leds.h>
 #include <ram_pwrdn.h>
 
@@ -31,6 +34,11 @@
 #include <zb_nrf_platform.h>
 #include "zb_swift_device.h"
 #include "adc.h"
+#include "txpower.h"
+#include "ota.h"
+#include "config.h"
+#include "governor.h"
+#include "ui.h"
 
 static const struct gpio_dt_spec probe_vdd = GPIO_DT_SPEC_GET(DT_NODELABEL(probe_vdd), gpios);
 
@@ -42,14 +50,64 @@ static const struct gpio_dt_spec probe_vdd = GPIO_DT_SPEC_GET(DT_NODELABEL(probe
  */
 #define SWIFT_INIT_BASIC_POWER_SOURCE    ZB_ZCL_BASIC_POWER_SOURCE_BATTERY
 
-/* LED indicating that device successfully joined Zigbee network. */
-#define ZIGBEE_NETWORK_STATE_LED            DK_LED1
+/* Hardware version, checked by OTA server against image requirements */
+#define SWIFT_INIT_BASIC_HW_VERSION      2
 
-/* Probe measurement interval */
-#define PROBE_INTERVAL_MS (CONFIG_PROBE_INTERVAL*1000)
+/* Probe measurement interval, stretched as battery runs down */
+#define PROBE_INTERVAL_S governor_interval(swift_config.probe_interval_s)
+
+/* Long poll interval, stretched as battery runs down */
+#define LONG_POLL_INTERVAL_MS (governor_long_poll(swift_config.long_poll_interval_s)*1000)
 
 LOG_MODULE_REGISTER(app, LOG_LEVEL_INF);
 
+#if defined(CONFIG_UART_CONSOLE) && defined(CONFIG_PM_DEVICE_RUNTIME)
+static const struct device *const console = DEVICE_DT_GET(DT_CHOSEN(zephyr_console));
+
+#define CONSOLE_FLUSH_TRIES 100 // Every 10ms
+
+static atomic_t console_held;
+static int console_flush_tries;
+
+/* Runs in system work queue, Zigbee stack thread must not wait for logs */
+static void console_release(struct k_work *work)
+{
+	// Let deferred logs out first
+	if (log_data_pending() && console_flush_tries++ < CONSOLE_FLUSH_TRIES) {
+	    k_work_reschedule(k_work_delayable_from_work(work), K_MSEC(10));
+	    return;
+	}
+
+	if (atomic_test_and_clear_bit(&console_held, 0)) {
+	    (void)pm_device_runtime_put(console);
+	}
+}
+
+static K_WORK_DELAYABLE_DEFINE(console_release_work, console_release);
+
+/* Console is only powered during measurement window, logs outside are dropped */
+static void console_resume(void)
+{
+	struct k_work_sync sync;
+
+	// Pending release is dropped, console is still held then
+	k_work_cancel_delayable_sync(&console_release_work, &sync);
+
+	if (!atomic_test_and_set_bit(&console_held, 0)) {
+	    (void)pm_device_runtime_get(console);
+	}
+}
+
+static void console_suspend(void)
+{
+	console_flush_tries = 0;
+	k_work_reschedule(&console_release_work, K_NO_WAIT);
+}
+#else
+static void console_resume(void) {}
+static void console_suspend(void) {}
+#endif
+
 /* Main application customizable context.
  * Stores all settings and static values.
  */
@@ -57,6 +115,7 @@ struct zb_device_ctx {
 	zb_zcl_basic_attrs_ext_t basic_attr;
 	zb_zcl_power_config_attrs_t power_config_attr;
 	zb_zcl_rel_humidity_attrs_t rel_humidity_attr;
+	zb_zcl_ota_upgrade_client_attrs_t ota_upgrade_attr;
 };
 
 /* Zigbee device application context storage. */
@@ -90,7 +149,39 @@ ZB_ZCL_DECLARE_POWER_CONFIG_ATTRIB_LIST2(
 	&dev_ctx.power_config_attr.alarm_state
 );
 
-ZB_DECLARE_SWIFT_DEVICE_CLUSTER_LIST(app_swift_clusters, basic_attr_list, power_config_attr_list, rel_humidity_attr_list);
+ZB_ZCL_DECLARE_OTA_UPGRADE_ATTRIB_LIST(
+	ota_upgrade_attr_list,
+	&dev_ctx.ota_upgrade_attr.upgrade_server,
+	&dev_ctx.ota_upgrade_attr.file_offset,
+	&dev_ctx.ota_upgrade_attr.file_version,
+	&dev_ctx.ota_upgrade_attr.stack_version,
+	&dev_ctx.ota_upgrade_attr.downloaded_file_ver,
+	&dev_ctx.ota_upgrade_attr.downloaded_stack_ver,
+	&dev_ctx.ota_upgrade_attr.image_status,
+	&dev_ctx.ota_upgrade_attr.manufacturer,
+	&dev_ctx.ota_upgrade_attr.image_type,
+	&dev_ctx.ota_upgrade_attr.min_block_reque,
+	&dev_ctx.ota_upgrade_attr.image_stamp,
+	&dev_ctx.ota_upgrade_attr.server_addr,
+	&dev_ctx.ota_upgrade_attr.server_ep,
+	SWIFT_INIT_BASIC_HW_VERSION,
+	OTA_IMAGE_BLOCK_DATA_SIZE_MAX,
+	ZB_ZCL_OTA_UPGRADE_QUERY_TIMER_COUNT_DEF
+);
+
+ZB_ZCL_DECLARE_SWIFT_CONFIG_ATTRIB_LIST(
+	swift_config_attr_list,
+	&swift_config.probe_interval_s,
+	&swift_config.probe_min_mv,
+	&swift_config.probe_max_mv,
+	&swift_config.probe_powerup_ms,
+	&swift_config.report_max_interval_s,
+	&swift_config.long_poll_interval_s,
+	&swift_config.battery_high_100mv,
+	&swift_config.battery_low_100mv
+);
+
+ZB_DECLARE_SWIFT_DEVICE_CLUSTER_LIST(app_swift_clusters, basic_attr_list, power_config_attr_list, rel_humidity_attr_list, swift_config_attr_list, ota_upgrade_attr_list);
 
 ZB_DECLARE_SWIFT_DEVICE_EP(
 	app_swift_ep,
@@ -108,9 +199,11 @@ ZBOSS_DECLARE_DEVICE_CTX_1_EP(
 #define SWIFT_INIT_BASIC_MODEL_ID        "Soil Moisture Sensor"
 
 /* Functions */
-void do_battery_measurement();
+void update_battery_attributes();
 void do_humidity_measurement(zb_uint8_t param);
-void check_join_status(zb_uint8_t param);
+void start_measurements(zb_uint8_t param);
+static void identify(zb_uint8_t param);
+static void set_reporting_intervals(void);
 
 /**@brief Function for initializing all clusters attributes. */
 static void app_clusters_attr_init(void)
@@ -118,6 +211,7 @@ static void app_clusters_attr_init(void)
 	/* Basic cluster attributes data */
 	dev_ctx.basic_attr.zcl_version = ZB_ZCL_VERSION;
 	dev_ctx.basic_attr.power_source = SWIFT_INIT_BASIC_POWER_SOURCE;
+	dev_ctx.basic_attr.hw_version = SWIFT_INIT_BASIC_HW_VERSION;
 
 	ZB_ZCL_SET_STRING_VAL(
 		dev_ctx.basic_attr.mf_name,
@@ -129,10 +223,29 @@ static void app_clusters_attr_init(void)
 		SWIFT_INIT_BASIC_MODEL_ID,
 		ZB_ZCL_STRING_CONST_SIZE(SWIFT_INIT_BASIC_MODEL_ID));
 
+	/* OTA Upgrade client attributes data. */
+	ZB_IEEE_ADDR_COPY(dev_ctx.ota_upgrade_attr.upgrade_server, ZB_ZCL_OTA_UPGRADE_SERVER_DEF_VALUE);
+	dev_ctx.ota_upgrade_attr.file_offset = ZB_ZCL_OTA_UPGRADE_FILE_OFFSET_DEF_VALUE;
+	dev_ctx.ota_upgrade_attr.file_version = CONFIG_OTA_FILE_VERSION;
+	dev_ctx.ota_upgrade_attr.stack_version = ZB_ZCL_OTA_UPGRADE_FILE_HEADER_STACK_PRO;
+	dev_ctx.ota_upgrade_attr.downloaded_file_ver = ZB_ZCL_OTA_UPGRADE_DOWNLOADED_FILE_VERSION_DEF_VALUE;
+	dev_ctx.ota_upgrade_attr.downloaded_stack_ver = ZB_ZCL_OTA_UPGRADE_DOWNLOADED_STACK_DEF_VALUE;
+	dev_ctx.ota_upgrade_attr.image_status = ZB_ZCL_OTA_UPGRADE_IMAGE_STATUS_DEF_VALUE;
+	dev_ctx.ota_upgrade_attr.manufacturer = CONFIG_SWIFT_MANUFACTURER_CODE;
+	dev_ctx.ota_upgrade_attr.image_type = CONFIG_OTA_IMAGE_TYPE;
+	dev_ctx.ota_upgrade_attr.min_block_reque = 0;
+	dev_ctx.ota_upgrade_attr.image_stamp = ZB_ZCL_OTA_UPGRADE_IMAGE_STAMP_MIN_VALUE;
+	dev_ctx.ota_upgrade_attr.server_addr = ZB_ZCL_OTA_UPGRADE_SERVER_ADDR_DEF_VALUE;
+	dev_ctx.ota_upgrade_attr.server_ep = ZB_ZCL_OTA_UPGRADE_SERVER_ENDPOINT_DEF_VALUE;
+
 	/* Power Config attributes data. */
 	dev_ctx.power_config_attr.voltage = ZB_ZCL_POWER_CONFIG_BATTERY_VOLTAGE_INVALID;
 
-	do_battery_measurement();
+	adc_resume();
+	governor_update(adc_battery()); // No load yet, filter will catch up
+	adc_suspend();
+
+	update_battery_attributes();
 
 	/* Relative Humidity cluster attributes data. */
 	dev_ctx.rel_humidity_attr.value = ZB_ZCL_ATTR_REL_HUMIDITY_MEASUREMENT_VALUE_UNKNOWN;
@@ -163,14 +276,42 @@ static void app_clusters_attr_init(void)
 		(zb_uint8_t *)&dev_ctx.rel_humidity_attr.max_value,
 		ZB_FALSE);
 
+	set_reporting_intervals();
+
+	/* Install reporting */
+	if (RET_OK != zb_zcl_start_attr_reporting(APP_SWIFT_ENDPOINT,
+						  ZB_ZCL_CLUSTER_ID_REL_HUMIDITY_MEASUREMENT,
+						  ZB_ZCL_CLUSTER_SERVER_ROLE,
+						  ZB_ZCL_ATTR_REL_HUMIDITY_MEASUREMENT_VALUE_ID)) {
+	    LOG_INF("Failed to start Attribute reporting");
+	}
+
+	if (RET_OK != zb_zcl_start_attr_reporting(APP_SWIFT_ENDPOINT,
+						  ZB_ZCL_CLUSTER_ID_POWER_CONFIG,
+						  ZB_ZCL_CLUSTER_SERVER_ROLE,
+						  ZB_ZCL_ATTR_POWER_CONFIG_BATTERY_PERCENTAGE_REMAINING_ID)) {
+	    LOG_INF("Failed to start Attribute reporting");
+	}
+
+	if (RET_OK != zb_zcl_start_attr_reporting(APP_SWIFT_ENDPOINT,
+						  ZB_ZCL_CLUSTER_ID_POWER_CONFIG,
+						  ZB_ZCL_CLUSTER_SERVER_ROLE,
+						  ZB_ZCL_ATTR_POWER_CONFIG_BATTERY_ALARM_STATE_ID)) {
+	    LOG_INF("Failed to start Attribute reporting");
+	}
+}
+
+/**@brief Function for setting default reporting intervals from configuration. */
+static void set_reporting_intervals(void)
+{
 	// Modify min reporting interval period
 	zb_zcl_reporting_info_t *rep_info;
 
 	rep_info = zb_zcl_find_reporting_info(APP_SWIFT_ENDPOINT, ZB_ZCL_CLUSTER_ID_REL_HUMIDITY_MEASUREMENT, ZB_ZCL_CLUSTER_SERVER_ROLE, ZB_ZCL_ATTR_REL_HUMIDITY_MEASUREMENT_VALUE_ID);
 
 	if (rep_info) {
-	    rep_info->u.send_info.def_min_interval = PROBE_INTERVAL_MS/1000;
-	    rep_info->u.send_info.def_max_interval = 7200; // 2 hours
+	    rep_info->u.send_info.def_min_interval = MIN(governor_interval(swift_config.probe_interval_s), UINT16_MAX);
+	    rep_info->u.send_info.def_max_interval = MIN(governor_interval(swift_config.report_max_interval_s), UINT16_MAX);
 	} else {
 	    LOG_ERR("Can't find HUMIDITY attribute");
 	}
@@ -178,42 +319,27 @@ static void app_clusters_attr_init(void)
 	rep_info = zb_zcl_find_reporting_info(APP_SWIFT_ENDPOINT, ZB_ZCL_CLUSTER_ID_POWER_CONFIG, ZB_ZCL_CLUSTER_SERVER_ROLE, ZB_ZCL_ATTR_POWER_CONFIG_BATTERY_PERCENTAGE_REMAINING_ID);
 
 	if (rep_info) {
-	    rep_info->u.send_info.def_min_interval = PROBE_INTERVAL_MS/1000;
-	    rep_info->u.send_info.def_max_interval = 7200; // 2 hours
+	    rep_info->u.send_info.def_min_interval = MIN(governor_interval(swift_config.probe_interval_s), UINT16_MAX);
+	    rep_info->u.send_info.def_max_interval = MIN(governor_interval(swift_config.report_max_interval_s), UINT16_MAX);
 	} else {
 	    LOG_ERR("Can't find POWER CONFIG attribute");
 	}
 
-	/* Install reporting */
-	if (RET_OK != zb_zcl_start_attr_reporting(APP_SWIFT_ENDPOINT,
-						  ZB_ZCL_CLUSTER_ID_REL_HUMIDITY_MEASUREMENT,
-						  ZB_ZCL_CLUSTER_SERVER_ROLE,
-						  ZB_ZCL_ATTR_REL_HUMIDITY_MEASUREMENT_VALUE_ID)) {
-	    LOG_INF("Failed to start Attribute reporting");
-	}
+	// Alarms are reported as soon as they are raised
+	rep_info = zb_zcl_find_reporting_info(APP_SWIFT_ENDPOINT, ZB_ZCL_CLUSTER_ID_POWER_CONFIG, ZB_ZCL_CLUSTER_SERVER_ROLE, ZB_ZCL_ATTR_POWER_CONFIG_BATTERY_ALARM_STATE_ID);
 
-	if (RET_OK != zb_zcl_start_attr_reporting(APP_SWIFT_ENDPOINT,
-						  ZB_ZCL_CLUSTER_ID_POWER_CONFIG,
-						  ZB_ZCL_CLUSTER_SERVER_ROLE,
-						  ZB_ZCL_ATTR_POWER_CONFIG_BATTERY_PERCENTAGE_REMAINING_ID)) {
-	    LOG_INF("Failed to start Attribute reporting");
+	if (rep_info) {
+	    rep_info->u.send_info.def_min_interval = 0;
+	    rep_info->u.send_info.def_max_interval = MIN(governor_interval(swift_config.report_max_interval_s), UINT16_MAX);
+	} else {
+	    LOG_ERR("Can't find BATTERY ALARM attribute");
 	}
 }
 
 /**@brief Function for initializing LEDs and Buttons. */
 static void configure_gpio(void)
 {
-	int err;
-
-	err = dk_buttons_init(NULL);
-	if (err) {
-		LOG_ERR("Cannot init buttons (err: %d)", err);
-	}
-
-	err = dk_leds_init();
-	if (err) {
-		LOG_ERR("Cannot init LEDs (err: %d)", err);
-	}
+	ui_init(identify);
 
 	if (!gpio_is_ready_dt(&probe_vdd)) {
 	    LOG_ERR("Can't get GPIO1.15 ready");
@@ -239,6 +365,14 @@ static void zcl_device_cb(zb_bufid_t bufid)
 	device_cb_param->status = RET_OK;
 
 	switch (device_cb_param->device_cb_id) {
+	case ZB_ZCL_OTA_UPGRADE_VALUE_CB_ID:
+		ota_upgrade_cb(&device_cb_param->cb_param.ota_value_param);
+		break;
+	case ZB_ZCL_SET_ATTR_VALUE_CB_ID:
+		if (device_cb_param->cb_param.set_attr_value_param.cluster_id == ZB_ZCL_CLUSTER_ID_SWIFT_CONFIG) {
+			config_written(); // Applied on next measurement
+		}
+		break;
 	default:
 		device_cb_param->status = RET_NOT_IMPLEMENTED;
 		break;
@@ -247,9 +381,20 @@ static void zcl_device_cb(zb_bufid_t bufid)
 	LOG_INF("%s status: %hd", __func__, device_cb_param->status);
 }
 
-static bool joined = false;
+static bool measuring = false;
 static bool first_start = false;
 
+/**@brief Identify gesture: measure now, and retry joining if it was given up. */
+static void identify(zb_uint8_t param)
+{
+	user_input_indicate();
+
+	if (measuring) {
+	    ZB_SCHEDULE_APP_ALARM_CANCEL(do_humidity_measurement, ZB_ALARM_ANY_PARAM);
+	    ZB_SCHEDULE_APP_CALLBACK(do_humidity_measurement, 0);
+	}
+}
+
 /**@brief Zigbee stack event handler.
  *
  * @param[in]   bufid   Reference to the Zigbee stack buffer
@@ -271,24 +416,23 @@ void zboss_signal_handler(zb_bufid_t bufid)
 	if (status == RET_OK) {
 	    LOG_INF("Joined network successfully");
 	    /* Change long poll interval once device has joined */
-	    zb_zdo_pim_set_long_poll_interval(120*1000); // 2 minutes should be enough
+	    zb_zdo_pim_set_long_poll_interval(LONG_POLL_INTERVAL_MS);
 
-	    joined = true;
-	} else {
-	    joined = false;
+	    txpower_apply(); // Restore adapted TX power level
+
+	    ota_confirm_image(); // This firmware made it to the network
+	    ota_client_start();
+
+	    if (!measuring) {
+		measuring = true;
+		ZB_SCHEDULE_APP_CALLBACK(start_measurements, 0);
+	    }
 	}
 	ZB_ERROR_CHECK(zigbee_default_signal_handler(bufid));
 	break;
     case ZB_ZDO_SIGNAL_LEAVE:
-	// Wait until Factory reset is released, then RESET
-	// Meanwhile fast LED blinking
-	while(dk_get_buttons() & DK_BTN3_MSK) {
-	    dk_set_led(ZIGBEE_NETWORK_STATE_LED, 0);
-	    k_msleep(50);
-	    dk_set_led(ZIGBEE_NETWORK_STATE_LED, 1);
-	    k_msleep(50);
-	}
-	sys_reboot(SYS_REBOOT_COLD);
+	// RESET once Factory reset button is released, meanwhile fast LED blinking
+	ui_leave();
 	break;
     case ZB_ZDO_SIGNAL_SKIP_STARTUP:
 	if (zigbee_is_stack_started() && (!zb_bdb_is_factory_new()) && (dk_get_buttons() & DK_BTN3_MSK)) {
@@ -313,30 +457,12 @@ void zboss_signal_handler(zb_bufid_t bufid)
 
 }
 
-#define BATTERY_HIGH_100MV 28
-#define BATTERY_LOW_100MV 16
-
-void do_battery_measurement() {
-	uint8_t battery_voltage;
+void update_battery_attributes() {
+	dev_ctx.power_config_attr.voltage = (uint8_t)(governor_voltage()/100); // 100mv per unit
+	dev_ctx.power_config_attr.percentage_remaining = governor_capacity()*2; // Half percent
+	dev_ctx.power_config_attr.alarm_state = governor_alarm_state();
 
-	battery_voltage = adc_battery(); // 100mv per unit
-
-	if (dev_ctx.power_config_attr.voltage != ZB_ZCL_POWER_CONFIG_BATTERY_VOLTAGE_INVALID) {
-	    // Low filter
-	    battery_voltage = (uint8_t)(((uint16_t)dev_ctx.power_config_attr.voltage * 3 + (uint16_t)battery_voltage + 2)/4);
-	}
-
-	dev_ctx.power_config_attr.voltage = battery_voltage;
-
-	if (battery_voltage > BATTERY_HIGH_100MV) {
-	    dev_ctx.power_config_attr.percentage_remaining = 200; // 200 half percent
-	} else if (battery_voltage < BATTERY_LOW_100MV) {
-	    dev_ctx.power_config_attr.percentage_remaining = 0;
-	} else {
-	    dev_ctx.power_config_attr.percentage_remaining = (battery_voltage-BATTERY_LOW_100MV)*200/(BATTERY_HIGH_100MV-BATTERY_LOW_100MV);
-	}
-
-	LOG_INF("Battery voltage (capacity): %d mv (%d%%)", battery_voltage*100, dev_ctx.power_config_attr.percentage_remaining/2);
+	LOG_INF("Battery voltage (capacity): %d mv (%d%%)", governor_voltage(), governor_capacity());
 
 	ZB_ZCL_SET_ATTRIBUTE(
 		APP_SWIFT_ENDPOINT,
@@ -353,33 +479,62 @@ void do_battery_measurement() {
 		ZB_ZCL_ATTR_POWER_CONFIG_BATTERY_PERCENTAGE_REMAINING_ID,
 		(zb_uint8_t *)&dev_ctx.power_config_attr.percentage_remaining,
 		ZB_FALSE);
+
+	ZB_ZCL_SET_ATTRIBUTE(
+		APP_SWIFT_ENDPOINT,
+		ZB_ZCL_CLUSTER_ID_POWER_CONFIG,
+		ZB_ZCL_CLUSTER_SERVER_ROLE,
+		ZB_ZCL_ATTR_POWER_CONFIG_BATTERY_ALARM_STATE_ID,
+		(zb_uint8_t *)&dev_ctx.power_config_attr.alarm_state,
+		ZB_FALSE);
 }
 
-void do_humidity_measurement(zb_uint8_t param) {
-#ifdef VDD_3V
-    // These comes from Capacitive Soil Moisture Sensor v1.2 powered by 3.0V
-#pragma message("Probe supply 3V")
-#define MIN_MV 450
-#define MAX_MV 1825
-#else
-    // These come from Capacitive Soil Moisture Sensor v1.2 powered by 3.3V
-#define MIN_MV 910
-#define MAX_MV 2160
-#endif
+/* ZB_MILLISECONDS_TO_BEACON_INTERVAL() overflows above ~4294s, long delays go through seconds */
+BUILD_ASSERT(((uint64_t)PROBE_INTERVAL_MAX_S << GOVERNOR_INTERVAL_SHIFT_MAX) * ZB_TIME_ONE_SECOND < ZB_HALF_MAX_TIME_VAL);
 
-#define PROBE_POWERUP_TIME_MS 1000
-#define COUNTDOWN_INIT (4*3600*1000/PROBE_INTERVAL_MS)
+static zb_time_t seconds_to_beacon_interval(uint32_t s)
+{
+	if (s > ZB_HALF_MAX_TIME_VAL / ZB_TIME_ONE_SECOND) {
+	    LOG_ERR("Delay %d s too long", s);
+	    s = ZB_HALF_MAX_TIME_VAL / ZB_TIME_ONE_SECOND;
+	}
+
+	return s * ZB_TIME_ONE_SECOND;
+}
+
+void do_humidity_measurement(zb_uint8_t param) {
+#define COUNTDOWN_INIT (4*3600/swift_config.probe_interval_s) // Stretched along with probe interval
 
 	int32_t val_mv;
 	uint16_t humidity; // 100 x H%
 	static uint16_t humidity_last = 0xffff;
-	static uint32_t force_report_countdown = COUNTDOWN_INIT; // When falling to 0, 4 hours, force reporting
+	static uint32_t force_report_countdown = UINT32_MAX; // When falling to 0, 4 hours, force reporting
+	bool stage_changed;
+
+	if (force_report_countdown == UINT32_MAX) {
+	    // Probe interval is only known once settings are loaded
+	    force_report_countdown = COUNTDOWN_INIT;
+	}
+
+	if (config_changed()) {
+	    // Configuration written since last cycle
+	    set_reporting_intervals();
+	    zb_zdo_pim_set_long_poll_interval(LONG_POLL_INTERVAL_MS);
+	    force_report_countdown = MIN(force_report_countdown, COUNTDOWN_INIT);
+	}
+
+	console_resume();
+	adc_resume();
 
-	dk_set_led(ZIGBEE_NETWORK_STATE_LED, 1);
+	ui_led(UI_LED_ON);
 
 	// Power on the probe
 	gpio_pin_set_dt(&probe_vdd,1);
-	k_msleep(PROBE_POWERUP_TIME_MS); // Wait for output to stabilize
+
+	// Meanwhile, check whether SAADC needs calibration and get temperature for probe compensation
+	adc_temperature_update();
+
+	k_msleep(swift_config.probe_powerup_ms); // Wait for output to stabilize
 
 	// Measurement
 	// Found out that multiple measurements must be done. Either probe or adapter hardware are not reliable.
@@ -394,19 +549,29 @@ void do_humidity_measurement(zb_uint8_t param) {
 	    k_msleep(100);
 	}
 
-	dk_set_led(ZIGBEE_NETWORK_STATE_LED, 0);
+	// Battery voltage under probe load tells more about remaining capacity
+	stage_changed = governor_update(adc_battery());
+
+	ui_led(UI_LED_OFF);
 
 	// Power off the probe
 	gpio_pin_set_dt(&probe_vdd,0);
 
-	if (val_mv < MIN_MV) {
+	if (stage_changed) {
+	    // Stretch or restore intervals, raise or clear battery alarm
+	    set_reporting_intervals();
+	    zb_zdo_pim_set_long_poll_interval(LONG_POLL_INTERVAL_MS);
+	    update_battery_attributes();
+	}
+
+	if (val_mv < swift_config.probe_min_mv) {
 	    humidity = 100; // Max humidity
-	} else if (val_mv > MAX_MV) {
+	} else if (val_mv > swift_config.probe_max_mv) {
 	    humidity = 0; // Min humidity
 	} else {
-	    // MIN_MV => 100% (water)
-	    // MAX_MV => 0% (air)
-	    humidity = 100-((val_mv - MIN_MV)*100/(MAX_MV-MIN_MV));
+	    // probe_min_mv => 100% (water)
+	    // probe_max_mv => 0% (air)
+	    humidity = 100-((val_mv - swift_config.probe_min_mv)*100/(swift_config.probe_max_mv-swift_config.probe_min_mv));
 	}
 
 	humidity *= 100;
@@ -421,7 +586,7 @@ void do_humidity_measurement(zb_uint8_t param) {
 	if (humidity/100 != humidity_last/100 || (force_report_countdown-- == 0)) {
 	    force_report_countdown = COUNTDOWN_INIT;
 
-	    do_battery_measurement(); // Take opportunity to update battery health
+	    update_battery_attributes(); // Take opportunity to update battery health
 
 	    dev_ctx.rel_humidity_attr.value = (humidity/10)*10; // Rounding at 10th
 
@@ -438,46 +603,52 @@ void do_humidity_measurement(zb_uint8_t param) {
 
 	humidity_last = humidity;
 
+	adc_suspend(); // Done with probe and battery
+
+	txpower_update(); // Adapt TX power to parent link quality
+
+	console_suspend();
+
 	if (first_start) {
 	    ZB_SCHEDULE_APP_ALARM(do_humidity_measurement, 0, ZB_MILLISECONDS_TO_BEACON_INTERVAL(15000)); // Shorten delay of next measurement
 	    first_start = false;
 	    force_report_countdown = 0; // Ugly, but this will force report on next call
 	} else {
-	    ZB_SCHEDULE_APP_ALARM(do_humidity_measurement, 0, ZB_MILLISECONDS_TO_BEACON_INTERVAL(PROBE_INTERVAL_MS));
+	    ZB_SCHEDULE_APP_ALARM(do_humidity_measurement, 0, seconds_to_beacon_interval(PROBE_INTERVAL_S));
 	}
 }
 
-#define NETWORK_LED_PERIOD_MS 200
-
-void check_join_status(zb_uint8_t param) {
-    static uint8_t led_state = 1;
-
-    if (joined) {
-	// Light off LED and start measurements
-	dk_set_led(ZIGBEE_NETWORK_STATE_LED, 0);
-	do_humidity_measurement(0);
-	return;
-    }
-
-    led_state ^= 1;
-
-    dk_set_led(ZIGBEE_NETWORK_STATE_LED, led_state);
-
-    ZB_SCHEDULE_APP_ALARM(check_join_status, 0, ZB_MILLISECONDS_TO_BEACON_INTERVAL(NETWORK_LED_PERIOD_MS));
+void start_measurements(zb_uint8_t param) {
+    // Light off LED and start measurements
+    ui_led(UI_LED_OFF);
+    do_humidity_measurement(0); // Also releases console held since start up
 }
 
 int main(void)
 {
+#if defined(CONFIG_UART_CONSOLE) && defined(CONFIG_PM_DEVICE_RUNTIME)
+	/* Console stays on until network is joined */
+	pm_device_runtime_enable(console);
+	console_resume();
+#endif
+
 	LOG_INF("Starting ADC reading on AIN0 and AIN1");
 	adc_setup();
 
 	LOG_INF("Starting Zigbee application swift example");
 
+	/* Restore persisted settings */
+	if (settings_subsys_init()) {
+		LOG_ERR("Cannot init settings");
+	} else {
+		settings_load();
+	}
+
 	/* Initialize */
 	configure_gpio();
 
-	/* Set Led on at startup */
-	dk_set_led(ZIGBEE_NETWORK_STATE_LED, 1);
+	/* Blink Led until network is joined */
+	ui_led(UI_LED_JOINING);
 
 	/* Register callback for handling ZCL commands. */
 	ZB_ZCL_REGISTER_DEVICE_CB(zcl_device_cb);
@@ -502,7 +673,5 @@ int main(void)
 
 	LOG_INF("Zigbee application swift started");
 
-	ZB_SCHEDULE_APP_ALARM(check_join_status, 0, ZB_MILLISECONDS_TO_BEACON_INTERVAL(NETWORK_LED_PERIOD_MS));
-
 	return 0;
 }
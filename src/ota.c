@@ -0,0 +1,328 @@
+/*
+ * Copyright (c) 2024 Olivier DEBON
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/storage/flash_map.h>
+#include <zephyr/dfu/flash_img.h>
+#include <zephyr/dfu/mcuboot.h>
+#include <zephyr/sys/reboot.h>
+#include <zephyr/sys/byteorder.h>
+
+#include <zboss_api.h>
+#include "delta.h"
+#include "ota.h"
+
+LOG_MODULE_REGISTER(ota, LOG_LEVEL_INF);
+
+#define OTA_HEADER_LENGTH_OFFSET 6 // OTA header length field, follows file id and header version
+#define OTA_ELEMENT_HEADER_SIZE 6 // Tag id and length
+#define OTA_REBOOT_DELAY_MS 2000
+
+enum {
+	OTA_STATE_HEADER,
+	OTA_STATE_ELEMENT_HEADER,
+	OTA_STATE_ELEMENT,
+	OTA_STATE_ERROR,
+};
+
+static struct {
+	struct flash_img_context flash;
+	struct delta_ctx delta;
+	const struct flash_area *primary;
+
+	uint8_t state;
+	uint8_t field[OTA_ELEMENT_HEADER_SIZE];
+	uint8_t field_len;
+
+	uint32_t offset; // In OTA file
+	uint32_t header_size;
+	uint32_t element_left;
+	uint16_t tag;
+	bool image_received;
+	bool delta_image;
+} ota;
+
+/* Delta applier callbacks, old image is the running one */
+static int ota_read_old(void *user, uint32_t offset, uint8_t *data, size_t len)
+{
+	if (offset + len > ota.primary->fa_size) {
+		return -EINVAL;
+	}
+
+	return flash_area_read(ota.primary, offset, data, len);
+}
+
+static int ota_write_new(void *user, const uint8_t *data, size_t len)
+{
+	return flash_img_buffered_write(&ota.flash, data, len, false);
+}
+
+static void ota_fast_poll(bool on)
+{
+	if (on) {
+	    // Re-armed on each block, falls back to long poll by itself if transfer stalls
+	    zb_zdo_pim_set_turbo_poll_max(CONFIG_OTA_FAST_POLL_MS);
+	    zb_zdo_pim_start_turbo_poll_continuous(CONFIG_OTA_FAST_POLL_TIMEOUT_MS);
+	} else {
+	    zb_zdo_pim_turbo_poll_continuous_leave(0);
+	}
+}
+
+static int ota_start(zb_zcl_ota_upgrade_value_param_t *value)
+{
+	int err;
+
+	if (value->upgrade.start.manufacturer != CONFIG_SWIFT_MANUFACTURER_CODE ||
+	    value->upgrade.start.image_type != CONFIG_OTA_IMAGE_TYPE ||
+	    value->upgrade.start.file_version <= CONFIG_OTA_FILE_VERSION) {
+	    LOG_INF("Skipping image 0x%04x/0x%04x version 0x%08x",
+		    value->upgrade.start.manufacturer,
+		    value->upgrade.start.image_type,
+		    value->upgrade.start.file_version);
+	    return -EINVAL;
+	}
+
+	memset(&ota, 0, sizeof(ota));
+
+	err = flash_area_open(FIXED_PARTITION_ID(slot0_partition), &ota.primary);
+	if (err) {
+	    LOG_ERR("Can't open primary slot (%d)", err);
+	    return err;
+	}
+
+	err = flash_img_init(&ota.flash);
+	if (err) {
+	    LOG_ERR("Can't open secondary slot (%d)", err);
+	    return err;
+	}
+
+	LOG_INF("Receiving image version 0x%08x, %d bytes",
+		value->upgrade.start.file_version, value->upgrade.start.file_length);
+
+	return 0;
+}
+
+static int ota_element(const uint8_t *data, size_t len)
+{
+	switch (ota.tag) {
+	case OTA_TAG_UPGRADE_IMAGE:
+	    return flash_img_buffered_write(&ota.flash, data, len, false);
+	case OTA_TAG_SWIFT_DELTA:
+	    return delta_write(&ota.delta, data, len);
+	default:
+	    return 0; // Skipped
+	}
+}
+
+static void ota_element_start(void)
+{
+	ota.tag = sys_get_le16(&ota.field[0]);
+	ota.element_left = sys_get_le32(&ota.field[2]);
+
+	if (ota.image_received) {
+	    ota.tag = UINT16_MAX; // Only one image per file, skip anything else (signature...)
+	}
+
+	switch (ota.tag) {
+	case OTA_TAG_SWIFT_DELTA:
+	    delta_init(&ota.delta, ota_read_old, ota_write_new, NULL);
+	    ota.delta_image = true;
+	    // Fallthru
+	case OTA_TAG_UPGRADE_IMAGE:
+	    LOG_INF("%s image, %d bytes", ota.tag == OTA_TAG_SWIFT_DELTA ? "Delta" : "Full", ota.element_left);
+	    ota.image_received = true;
+	    break;
+	default:
+	    break;
+	}
+}
+
+/* OTA file blocks come in order, parse them on the fly */
+static int ota_receive(const uint8_t *data, size_t len)
+{
+	int err;
+
+	while (len) {
+		switch (ota.state) {
+		case OTA_STATE_HEADER:
+			if (ota.offset == OTA_HEADER_LENGTH_OFFSET || ota.offset == OTA_HEADER_LENGTH_OFFSET + 1) {
+				ota.header_size |= *data << (8 * (ota.offset - OTA_HEADER_LENGTH_OFFSET));
+			}
+			data++;
+			len--;
+			ota.offset++;
+			if (ota.offset > OTA_HEADER_LENGTH_OFFSET + 1 && ota.offset >= ota.header_size) {
+				ota.state = OTA_STATE_ELEMENT_HEADER;
+			}
+			break;
+		case OTA_STATE_ELEMENT_HEADER:
+			ota.field[ota.field_len++] = *data++;
+			len--;
+			ota.offset++;
+			if (ota.field_len == OTA_ELEMENT_HEADER_SIZE) {
+				ota.field_len = 0;
+				ota_element_start();
+				ota.state = ota.element_left ? OTA_STATE_ELEMENT : OTA_STATE_ELEMENT_HEADER;
+			}
+			break;
+		case OTA_STATE_ELEMENT: {
+			size_t n = MIN(len, ota.element_left);
+
+			err = ota_element(data, n);
+			if (err) {
+				LOG_ERR("Can't write image (%d)", err);
+				ota.state = OTA_STATE_ERROR;
+				return err;
+			}
+			data += n;
+			len -= n;
+			ota.offset += n;
+			ota.element_left -= n;
+			if (ota.element_left == 0) {
+				ota.state = OTA_STATE_ELEMENT_HEADER;
+			}
+			break;
+		}
+		default:
+			return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
+static int ota_check(void)
+{
+	int err;
+
+	if (!ota.image_received || ota.state != OTA_STATE_ELEMENT_HEADER || ota.field_len) {
+	    LOG_ERR("Incomplete image");
+	    return -EINVAL;
+	}
+
+	if (ota.delta_image) {
+	    err = delta_finish(&ota.delta);
+	    if (err) {
+		LOG_ERR("Delta image doesn't match");
+		return err;
+	    }
+	}
+
+	err = flash_img_buffered_write(&ota.flash, NULL, 0, true);
+	if (err) {
+	    LOG_ERR("Can't flush image (%d)", err);
+	    return err;
+	}
+
+	LOG_INF("Image stored, %d bytes", flash_img_bytes_written(&ota.flash));
+
+	return 0;
+}
+
+static void ota_reboot(zb_uint8_t param)
+{
+	sys_reboot(SYS_REBOOT_COLD);
+}
+
+static void ota_end(void)
+{
+	ota_fast_poll(false);
+
+	if (ota.primary) {
+	    flash_area_close(ota.primary);
+	    ota.primary = NULL;
+	}
+}
+
+void ota_upgrade_cb(zb_zcl_ota_upgrade_value_param_t *value)
+{
+	switch (value->upgrade_status) {
+	case ZB_ZCL_OTA_UPGRADE_STATUS_START:
+	    if (ota_start(value)) {
+		value->upgrade_status = ZB_ZCL_OTA_UPGRADE_STATUS_ERROR;
+		ota_end();
+		break;
+	    }
+	    ota_fast_poll(true);
+	    value->upgrade_status = ZB_ZCL_OTA_UPGRADE_STATUS_OK;
+	    break;
+	case ZB_ZCL_OTA_UPGRADE_STATUS_RECEIVE:
+	    if (value->upgrade.receive.file_offset != ota.offset ||
+		ota_receive(value->upgrade.receive.block_data, value->upgrade.receive.data_length)) {
+		value->upgrade_status = ZB_ZCL_OTA_UPGRADE_STATUS_ERROR;
+		ota_end();
+		break;
+	    }
+	    ota_fast_poll(true);
+	    value->upgrade_status = ZB_ZCL_OTA_UPGRADE_STATUS_OK;
+	    break;
+	case ZB_ZCL_OTA_UPGRADE_STATUS_CHECK:
+	    value->upgrade_status = ota_check() ? ZB_ZCL_OTA_UPGRADE_STATUS_ERROR : ZB_ZCL_OTA_UPGRADE_STATUS_OK;
+	    ota_end(); // Back to long poll while waiting for upgrade time
+	    break;
+	case ZB_ZCL_OTA_UPGRADE_STATUS_APPLY:
+	    if (boot_request_upgrade(BOOT_UPGRADE_TEST)) {
+		LOG_ERR("Can't request upgrade");
+		value->upgrade_status = ZB_ZCL_OTA_UPGRADE_STATUS_ERROR;
+		break;
+	    }
+	    value->upgrade_status = ZB_ZCL_OTA_UPGRADE_STATUS_OK;
+	    break;
+	case ZB_ZCL_OTA_UPGRADE_STATUS_FINISH:
+	    LOG_INF("Upgrade done, rebooting");
+	    // Let stack send Upgrade End Request before
+	    ZB_SCHEDULE_APP_ALARM(ota_reboot, 0, ZB_MILLISECONDS_TO_BEACON_INTERVAL(OTA_REBOOT_DELAY_MS));
+	    value->upgrade_status = ZB_ZCL_OTA_UPGRADE_STATUS_OK;
+	    break;
+	case ZB_ZCL_OTA_UPGRADE_STATUS_ABORT:
+	    LOG_INF("Upgrade aborted");
+	    ota_end();
+	    value->upgrade_status = ZB_ZCL_OTA_UPGRADE_STATUS_OK;
+	    break;
+	case ZB_ZCL_OTA_UPGRADE_STATUS_SERVER_NOT_FOUND:
+	    LOG_INF("No OTA server found");
+	    value->upgrade_status = ZB_ZCL_OTA_UPGRADE_STATUS_OK;
+	    break;
+	default:
+	    value->upgrade_status = ZB_ZCL_OTA_UPGRADE_STATUS_OK;
+	    break;
+	}
+}
+
+void ota_client_start(void)
+{
+	static bool started = false;
+
+	// Stack keeps querying periodically once started, rejoins must not restart it
+	if (started) {
+	    return;
+	}
+
+	if (zb_buf_get_out_delayed(zb_zcl_ota_upgrade_init_client) != RET_OK) {
+	    LOG_ERR("No buffer to start OTA client");
+	    return;
+	}
+
+	started = true;
+}
+
+void ota_confirm_image(void)
+{
+	if (boot_is_img_confirmed()) {
+	    return;
+	}
+
+	// Network is reachable with this image, MCUboot shall not revert
+	if (boot_write_img_confirmed()) {
+	    LOG_ERR("Can't confirm image");
+	} else {
+	    LOG_INF("Image confirmed");
+	}
+}
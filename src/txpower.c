@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2024 Olivier DEBON
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include <stdint.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/settings/settings.h>
+
+#include <zboss_api.h>
+#include "txpower.h"
+
+LOG_MODULE_REGISTER(txpower, LOG_LEVEL_INF);
+
+/* TX power steps supported by nRF52840 radio (dBm), highest first */
+static const int8_t tx_power_steps[] = { 8, 4, 0, -4, -8, -12, -16, -20 };
+
+#define TX_POWER_STEPS ARRAY_SIZE(tx_power_steps)
+#define RSSI_UNKNOWN INT16_MIN
+
+static int8_t tx_power_dbm = CONFIG_TXPOWER_MAX_DBM; // Persisted
+static int16_t rssi_last = RSSI_UNKNOWN;
+static uint8_t good_count;
+static uint8_t rejoin_wait; // Cycles before another rejoin is allowed
+
+/* Index of first step not above given power */
+static int step_index(int8_t dbm)
+{
+	for (int i = 0; i < TX_POWER_STEPS; i++) {
+		if (tx_power_steps[i] <= dbm) {
+			return i;
+		}
+	}
+
+	return TX_POWER_STEPS - 1;
+}
+
+static int txpower_settings_set(const char *name, size_t len,
+				settings_read_cb read_cb, void *cb_arg)
+{
+	int8_t dbm;
+
+	if (!settings_name_steq(name, "dbm", NULL) || len != sizeof(dbm)) {
+		return -ENOENT;
+	}
+
+	if (read_cb(cb_arg, &dbm, sizeof(dbm)) < 0) {
+		return -EIO;
+	}
+
+	// Do not trust stored value beyond current bounds
+	dbm = CLAMP(dbm, CONFIG_TXPOWER_MIN_DBM, CONFIG_TXPOWER_MAX_DBM);
+	tx_power_dbm = tx_power_steps[step_index(dbm)];
+
+	LOG_INF("Restored TX power %d dBm", tx_power_dbm);
+
+	return 0;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(txpower, "txpower", NULL, txpower_settings_set, NULL, NULL);
+
+static void txpower_set_cb(zb_bufid_t bufid)
+{
+	zb_tx_power_params_t *params = ZB_BUF_GET_PARAM(bufid, zb_tx_power_params_t);
+
+	if (params->status != RET_OK) {
+	    LOG_ERR("Can't set TX power %d dBm (%d)", params->tx_power, params->status);
+	} else {
+	    LOG_INF("TX power set to %d dBm", params->tx_power);
+	}
+
+	zb_buf_free(bufid);
+}
+
+static void txpower_set(zb_bufid_t bufid, zb_uint16_t dbm)
+{
+	zb_tx_power_params_t *params = ZB_BUF_GET_PARAM(bufid, zb_tx_power_params_t);
+
+	params->page = zb_get_current_page();
+	params->channel = zb_get_current_channel();
+	params->tx_power = (zb_int8_t)(int16_t)dbm;
+	params->cb = txpower_set_cb;
+
+	zb_set_tx_power_async(bufid);
+}
+
+void txpower_apply(void)
+{
+	if (zb_buf_get_out_delayed_ext(txpower_set, (zb_uint16_t)(int16_t)tx_power_dbm, 0) != RET_OK) {
+	    LOG_ERR("No buffer to set TX power");
+	}
+}
+
+static void txpower_change(int8_t dbm)
+{
+	if (dbm == tx_power_dbm) {
+	    return;
+	}
+
+	tx_power_dbm = dbm;
+	good_count = 0;
+
+	txpower_apply();
+
+	// Only written on change, this is rare enough for flash wear
+	if (settings_save_one("txpower/dbm", &tx_power_dbm, sizeof(tx_power_dbm))) {
+	    LOG_ERR("Can't persist TX power");
+	}
+}
+
+void txpower_update(void)
+{
+	zb_uint16_t parent;
+	zb_uint8_t lqi;
+	zb_int8_t rssi;
+	int16_t headroom;
+	int index;
+	int max_index = step_index(CONFIG_TXPOWER_MAX_DBM);
+	int min_index = step_index(CONFIG_TXPOWER_MIN_DBM);
+
+	parent = zb_nwk_get_parent();
+
+	if (parent == ZB_UNKNOWN_SHORT_ADDR) {
+	    return;
+	}
+
+	// Link figures are refreshed by every frame from parent, i.e. MAC poll responses
+	if (!zb_zdo_get_diag_data(parent, &lqi, &rssi)) {
+	    LOG_INF("No link data for parent 0x%04x", parent);
+	    return;
+	}
+
+	// Low filter
+	if (rssi_last != RSSI_UNKNOWN) {
+	    rssi = (zb_int8_t)((rssi_last*3 + rssi - 2)/4);
+	}
+
+	rssi_last = rssi;
+
+	LOG_INF("Parent 0x%04x LQI %d RSSI %d dBm, TX %d dBm", parent, lqi, rssi, tx_power_dbm);
+
+	if (rejoin_wait) {
+	    rejoin_wait--;
+	}
+
+	if (lqi < CONFIG_TXPOWER_LQI_LINK_LOST || rssi < CONFIG_TXPOWER_RSSI_LINK_LOST) {
+	    if (tx_power_dbm != tx_power_steps[max_index]) {
+		LOG_WRN("Parent link degraded, back to full power");
+		txpower_change(tx_power_steps[max_index]);
+	    }
+	    // Even at full power, another parent may do better
+	    if (!rejoin_wait) {
+		LOG_WRN("Parent link degraded, rejoining");
+		rejoin_wait = CONFIG_TXPOWER_REJOIN_INTERVAL;
+		rssi_last = RSSI_UNKNOWN;
+		zb_zdo_rejoin_backoff_start(ZB_FALSE);
+	    }
+	    return;
+	}
+
+	// Expected level of our frames at parent above target, assuming a
+	// symmetrical link and parent transmitting at full power.
+	headroom = rssi + tx_power_dbm - tx_power_steps[max_index] - CONFIG_TXPOWER_RSSI_TARGET;
+	index = step_index(tx_power_dbm);
+
+	if (headroom < 0) {
+	    // Step up at once
+	    if (index > max_index) {
+		txpower_change(tx_power_steps[index-1]);
+	    }
+	    good_count = 0;
+	} else if (index < min_index &&
+		   headroom - (tx_power_steps[index] - tx_power_steps[index+1]) >= CONFIG_TXPOWER_HYSTERESIS_DB) {
+	    // Step down only when link has been good for a while
+	    if (++good_count >= CONFIG_TXPOWER_STEP_DOWN_COUNT) {
+		txpower_change(tx_power_steps[index+1]);
+	    }
+	} else {
+	    good_count = 0;
+	}
+}
@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2024 Olivier DEBON
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/reboot.h>
+#include <dk_buttons_and_leds.h>
+
+#include <zboss_api.h>
+#include <zb_nrf_platform.h>
+#include "ui.h"
+
+LOG_MODULE_REGISTER(ui, LOG_LEVEL_INF);
+
+#define UI_BUTTON DK_BTN3_MSK
+#define UI_LED DK_LED1
+
+#define LONG_PRESS_MS 5000
+
+static const struct {
+	uint16_t period_ms; // LED toggle period, 0 for steady
+	uint16_t duration_ms; // 0 for endless, else back to endless pattern afterwards
+} patterns[] = {
+	[UI_LED_OFF] = { 0, 0 },
+	[UI_LED_ON] = { 0, 0 },
+	[UI_LED_JOINING] = { 200, 0 },
+	[UI_LED_IDENTIFY] = { 500, 5000 },
+	[UI_LED_RESET] = { 50, 0 },
+};
+
+static zb_callback_t identify;
+static atomic_t reboot_on_release;
+static bool long_press;
+static struct k_spinlock led_lock; // ui_led() is called from Zigbee thread, work queue and timer
+static enum ui_led_pattern base_pattern = UI_LED_OFF; // Last endless pattern
+static bool led_state;
+static int64_t pattern_end; // Temporary pattern running until then, 0 otherwise
+
+static void led_timer_handler(struct k_timer *timer);
+
+K_TIMER_DEFINE(led_timer, led_timer_handler, NULL);
+
+static void led_start(enum ui_led_pattern pattern)
+{
+	k_timer_stop(&led_timer);
+
+	led_state = pattern != UI_LED_OFF;
+	dk_set_led(UI_LED, led_state);
+
+	pattern_end = patterns[pattern].duration_ms ? k_uptime_get() + patterns[pattern].duration_ms : 0;
+
+	if (patterns[pattern].period_ms) {
+		k_timer_start(&led_timer, K_MSEC(patterns[pattern].period_ms), K_MSEC(patterns[pattern].period_ms));
+	}
+}
+
+static void led_timer_handler(struct k_timer *timer)
+{
+	k_spinlock_key_t key = k_spin_lock(&led_lock);
+
+	if (pattern_end && k_uptime_get() >= pattern_end) {
+		led_start(base_pattern);
+	} else {
+		led_state = !led_state;
+		dk_set_led(UI_LED, led_state);
+	}
+
+	k_spin_unlock(&led_lock, key);
+}
+
+void ui_led(enum ui_led_pattern pattern)
+{
+	k_spinlock_key_t key = k_spin_lock(&led_lock);
+
+	if (patterns[pattern].duration_ms == 0) {
+		base_pattern = pattern;
+	}
+
+	// Temporary pattern goes on, it falls back to new endless one. Factory reset wins.
+	if (!pattern_end || patterns[pattern].duration_ms || pattern == UI_LED_RESET) {
+		led_start(pattern);
+	}
+
+	k_spin_unlock(&led_lock, key);
+}
+
+static void long_press_handler(struct k_work *work)
+{
+	long_press = true;
+
+	LOG_INF("FACTORY RESET BUTTON long press - Scheduling Factory Reset");
+
+	ui_led(UI_LED_RESET);
+
+	// Leave signal follows, device reboots once button is released
+	if (zigbee_schedule_callback(zb_bdb_reset_via_local_action, 0)) {
+		LOG_ERR("Can't schedule factory reset");
+	}
+}
+
+static K_WORK_DELAYABLE_DEFINE(long_press_work, long_press_handler);
+
+/* Called from system work queue on GPIO interrupt */
+static void button_changed(uint32_t button_state, uint32_t has_changed)
+{
+	if (!(has_changed & UI_BUTTON)) {
+		return;
+	}
+
+	if (button_state & UI_BUTTON) {
+		long_press = false;
+		k_work_schedule(&long_press_work, K_MSEC(LONG_PRESS_MS));
+		return;
+	}
+
+	// Released
+	if (atomic_get(&reboot_on_release)) {
+		sys_reboot(SYS_REBOOT_COLD);
+	}
+
+	k_work_cancel_delayable(&long_press_work);
+
+	if (!long_press) {
+		ui_led(UI_LED_IDENTIFY);
+		if (identify && zigbee_schedule_callback(identify, 0)) {
+			LOG_ERR("Can't schedule identify");
+		}
+	}
+}
+
+void ui_leave(void)
+{
+	atomic_set(&reboot_on_release, 1);
+
+	// Released before flag was set, callback won't come
+	if (!(dk_get_buttons() & UI_BUTTON)) {
+		sys_reboot(SYS_REBOOT_COLD);
+	}
+
+	ui_led(UI_LED_RESET);
+}
+
+void ui_init(zb_callback_t identify_cb)
+{
+	int err;
+
+	identify = identify_cb;
+
+	err = dk_buttons_init(button_changed);
+	if (err) {
+		LOG_ERR("Cannot init buttons (err: %d)", err);
+	}
+
+	err = dk_leds_init();
+	if (err) {
+		LOG_ERR("Cannot init LEDs (err: %d)", err);
+	}
+}
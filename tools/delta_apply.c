@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2024 Olivier DEBON
+ *
+ * SPDX-License-Identifier: AGPL-3.0-or-later
+ */
+
+/*
+ * Host build of firmware delta applier, checks patches produced by
+ * swift_ota.py go through src/delta.c the same way device does.
+ *
+ *   delta_apply OLD PATCH NEW
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "delta.h"
+
+struct files {
+	FILE *old;
+	FILE *new;
+};
+
+static int read_old(void *user, uint32_t offset, uint8_t *data, size_t len)
+{
+	struct files *f = user;
+
+	if (fseek(f->old, offset, SEEK_SET) || fread(data, 1, len, f->old) != len) {
+		return -EIO;
+	}
+
+	return 0;
+}
+
+static int write_new(void *user, const uint8_t *data, size_t len)
+{
+	struct files *f = user;
+
+	return fwrite(data, 1, len, f->new) == len ? 0 : -EIO;
+}
+
+int main(int argc, char *argv[])
+{
+	struct delta_ctx ctx;
+	struct files f;
+	FILE *patch;
+	uint8_t buf[64]; // Zigbee OTA blocks are even smaller
+	size_t len;
+	int err = 0;
+
+	if (argc != 4) {
+		fprintf(stderr, "usage: %s OLD PATCH NEW\n", argv[0]);
+		return 2;
+	}
+
+	f.old = fopen(argv[1], "rb");
+	patch = fopen(argv[2], "rb");
+	f.new = fopen(argv[3], "wb");
+
+	if (!f.old || !patch || !f.new) {
+		perror("open");
+		return 1;
+	}
+
+	delta_init(&ctx, read_old, write_new, &f);
+
+	while (!err && (len = fread(buf, 1, sizeof(buf), patch)) > 0) {
+		err = delta_write(&ctx, buf, len);
+	}
+
+	if (!err) {
+		err = delta_finish(&ctx);
+	}
+
+	fclose(f.old);
+	fclose(patch);
+	fclose(f.new);
+
+	if (err) {
+		fprintf(stderr, "delta failed (%d)\n", err);
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,243 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2024 Olivier DEBON
+# SPDX-License-Identifier: AGPL-3.0-or-later
+#
+
+"""Build Zigbee OTA files for Swift Soil Moisture Sensor.
+
+  diff  OLD NEW PATCH     build delta from OLD to NEW MCUboot images (app_update.bin)
+  patch OLD PATCH NEW     apply delta, same algorithm as src/delta.c
+  ota   IMAGE OUT         wrap full image or delta (--delta OLD) in a Zigbee OTA file
+
+Delta format is described in include/delta.h.
+"""
+
+import argparse
+import struct
+import sys
+import zlib
+
+DELTA_MAGIC = b"SWDL"
+
+OTA_FILE_ID = 0x0BEEF11E
+OTA_HEADER_VERSION = 0x0100
+OTA_HEADER_SIZE = 56
+OTA_STACK_PRO = 0x0002
+OTA_TAG_UPGRADE_IMAGE = 0x0000
+OTA_TAG_SWIFT_DELTA = 0xF000  # Manufacturer specific tag range
+
+KEY = 8          # Bytes indexed in old image
+MIN_MATCH = 16   # Shorter matches are sent as extra bytes
+CANDIDATES = 16  # Old positions remembered per key
+
+
+def crc32(data):
+    return zlib.crc32(data) & 0xFFFFFFFF
+
+
+def exact_len(old, o, new, n):
+    """Length of common prefix of old[o:] and new[n:]."""
+    size = min(len(old) - o, len(new) - n)
+    length = 0
+    step = 64
+    while length < size:
+        step = min(step, size - length)
+        if old[o + length:o + length + step] == new[n + length:n + length + step]:
+            length += step
+            step *= 2
+        elif step > 1:
+            step //= 2
+        else:
+            break
+    return length
+
+
+def approx_len(old, o, new, n):
+    """Extend match while more than half of the bytes agree, bsdiff fashion.
+
+    Mismatching bytes are coded in the diff block, which is cheaper than
+    extra bytes as long as most of the diff stays zero.
+    """
+    size = min(len(old) - o, len(new) - n)
+    best = same = length = 0
+    while length < size and length - best <= 32:
+        if old[o + length] == new[n + length]:
+            same += 1
+            if same * 2 > length + 1:
+                best = length + 1
+        length += 1
+    return best
+
+
+def encode_diff(old, o, new, n, length):
+    out = bytearray()
+    i = 0
+    while i < length:
+        d = (new[n + i] - old[o + i]) & 0xFF
+        if d:
+            out.append(d)
+            i += 1
+            continue
+        run = 1
+        while run < 256 and i + run < length and new[n + i + run] == old[o + i + run]:
+            run += 1
+        out += bytes((0, run - 1))
+        i += run
+    return out
+
+
+def diff(old, new):
+    index = {}
+    for o in range(len(old) - KEY + 1):
+        positions = index.setdefault(old[o:o + KEY], [])
+        if len(positions) < CANDIDATES:
+            positions.append(o)
+
+    matches = []  # (new position, old position, length)
+    n = 0
+    last_old = 0
+    while n <= len(new) - KEY:
+        best_len = best_old = 0
+        # Prefer continuing where previous match stopped, code often shifts as a whole
+        candidates = [last_old] if last_old <= len(old) - KEY else []
+        candidates += index.get(new[n:n + KEY], [])
+        for o in candidates:
+            length = exact_len(old, o, new, n)
+            if length > best_len:
+                best_len, best_old = length, o
+        if best_len < MIN_MATCH:
+            n += 1
+            continue
+        length = best_len + approx_len(old, best_old + best_len, new, n + best_len)
+        matches.append((n, best_old, length))
+        n += length
+        last_old = best_old + length
+
+    out = bytearray(DELTA_MAGIC)
+    out += struct.pack("<IIII", len(old), crc32(old), len(new), crc32(new))
+
+    # Leading bytes before first match
+    first = matches[0] if matches else (len(new), 0, 0)
+    if new and (first[0] > 0 or first[1] > 0):
+        out += struct.pack("<IIi", 0, first[0], first[1])
+        out += new[:first[0]]
+
+    for i, (n, o, length) in enumerate(matches):
+        end = matches[i + 1][0] if i + 1 < len(matches) else len(new)
+        next_old = matches[i + 1][1] if i + 1 < len(matches) else o + length
+        out += struct.pack("<IIi", length, end - n - length, next_old - (o + length))
+        out += encode_diff(old, o, new, n, length)
+        out += new[n + length:end]
+
+    return bytes(out)
+
+
+def patch(old, delta):
+    if delta[:4] != DELTA_MAGIC:
+        raise ValueError("not a delta image")
+    old_size, old_crc, new_size, new_crc = struct.unpack_from("<IIII", delta, 4)
+    if old_size > len(old) or crc32(old[:old_size]) != old_crc:
+        raise ValueError("base image mismatch")
+
+    new = bytearray()
+    p = 20
+    old_pos = 0
+    while len(new) < new_size:
+        diff_len, extra_len, seek = struct.unpack_from("<IIi", delta, p)
+        p += 12
+        i = 0
+        while i < diff_len:
+            b = delta[p]
+            p += 1
+            if b:
+                new.append((old[old_pos + i] + b) & 0xFF)
+                i += 1
+            else:
+                run = delta[p] + 1
+                p += 1
+                new += old[old_pos + i:old_pos + i + run]
+                i += run
+        old_pos += diff_len
+        new += delta[p:p + extra_len]
+        p += extra_len
+        old_pos += seek
+
+    if p != len(delta) or crc32(new) != new_crc:
+        raise ValueError("corrupted delta image")
+    return bytes(new)
+
+
+def ota(image, tag, manufacturer, image_type, version, header_string):
+    element = struct.pack("<HI", tag, len(image)) + image
+    header = struct.pack("<IHHHHHIH32sI",
+                         OTA_FILE_ID, OTA_HEADER_VERSION, OTA_HEADER_SIZE,
+                         0,  # Field control, no optional field
+                         manufacturer, image_type, version, OTA_STACK_PRO,
+                         header_string.encode()[:32].ljust(32, b"\0"),
+                         OTA_HEADER_SIZE + len(element))
+    return header + element
+
+
+def read(path):
+    with open(path, "rb") as f:
+        return f.read()
+
+
+def write(path, data):
+    with open(path, "wb") as f:
+        f.write(data)
+
+
+def checked_diff(old, new):
+    """Delta from old to new, verified by applying it back."""
+    delta = diff(old, new)
+    if patch(old, delta) != new:
+        sys.exit("delta check failed")
+    return delta
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = parser.add_subparsers(dest="cmd", required=True)
+
+    p = sub.add_parser("diff")
+    p.add_argument("old")
+    p.add_argument("new")
+    p.add_argument("patch")
+
+    p = sub.add_parser("patch")
+    p.add_argument("old")
+    p.add_argument("patch")
+    p.add_argument("new")
+
+    p = sub.add_parser("ota")
+    p.add_argument("image")
+    p.add_argument("out")
+    p.add_argument("--delta", metavar="OLD", help="base image currently running on devices")
+    p.add_argument("--manufacturer", type=lambda v: int(v, 0), default=0x1234)
+    p.add_argument("--image-type", type=lambda v: int(v, 0), default=0x0001)
+    p.add_argument("--version", type=lambda v: int(v, 0), required=True)
+    p.add_argument("--header-string", default="Swift Soil Moisture Sensor")
+
+    args = parser.parse_args()
+
+    if args.cmd == "diff":
+        old, new = read(args.old), read(args.new)
+        delta = checked_diff(old, new)
+        write(args.patch, delta)
+        print(f"{len(new)} -> {len(delta)} bytes ({100 * len(delta) // max(len(new), 1)}%)")
+    elif args.cmd == "patch":
+        write(args.new, patch(read(args.old), read(args.patch)))
+    else:
+        image = read(args.image)
+        tag = OTA_TAG_UPGRADE_IMAGE
+        if args.delta:
+            old = read(args.delta)
+            image = checked_diff(old, image)
+            tag = OTA_TAG_SWIFT_DELTA
+        write(args.out, ota(image, tag, args.manufacturer, args.image_type, args.version, args.header_string))
+
+
+if __name__ == "__main__":
+    main()